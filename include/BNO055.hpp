@@ -2,6 +2,7 @@
 #define IMU_BNO055_HPP
 
 #include <EVT/io/I2C.hpp>
+#include <Profiler.hpp>
 #include <EVT/utils/log.hpp>
 #include <EVT/utils/time.hpp>
 
@@ -10,6 +11,8 @@
 
 /* Page id register definition */
 #define BNO055_PAGE_ID_ADDR (0X07)
+#define BNO055_PAGE_0 (0x00)
+#define BNO055_PAGE_1 (0x01)
 
 /* Mode registers */
 #define BNO055_OPR_MODE_ADDR (0X3D)
@@ -17,6 +20,31 @@
 
 #define BNO055_SYS_TRIGGER_ADDR (0X3F)
 
+/** Page 0 configuration registers */
+#define BNO055_UNIT_SEL_ADDR (0X3B)
+#define BNO055_TEMP_SOURCE_ADDR (0X40)
+#define BNO055_AXIS_MAP_CONFIG_ADDR (0X41)
+#define BNO055_AXIS_MAP_SIGN_ADDR (0X42)
+
+/** Page 1 configuration registers */
+#define BNO055_ACC_CONFIG_ADDR (0X08)
+#define BNO055_MAG_CONFIG_ADDR (0X09)
+#define BNO055_GYR_CONFIG_0_ADDR (0X0A)
+#define BNO055_GYR_CONFIG_1_ADDR (0X0B)
+#define BNO055_ACC_SLEEP_CONFIG_ADDR (0X0C)
+#define BNO055_GYR_SLEEP_CONFIG_ADDR (0X0D)
+#define BNO055_INT_MSK_ADDR (0X0F)
+#define BNO055_INT_EN_ADDR (0X10)
+#define BNO055_ACC_AM_THRES_ADDR (0X11)
+#define BNO055_ACC_INT_SETTINGS_ADDR (0X12)
+#define BNO055_ACC_NM_THRES_ADDR (0X15)
+#define BNO055_ACC_NM_SET_ADDR (0X16)
+#define BNO055_GYR_AM_SET_ADDR (0X1F)
+
+/** Mode switching times in ms (datasheet table 3-6) */
+#define BNO055_CONFIG_TO_ANY_DELAY (7)
+#define BNO055_ANY_TO_CONFIG_DELAY (19)
+
 /** BNO055 Registers **/
 #define BNO055_ACCEL_DATA_X_LSB_ADDR (0X08)
 #define BNO055_MAG_DATA_X_LSB_ADDR (0X0E)
@@ -26,6 +54,7 @@
 #define BNO055_LINEAR_ACCEL_DATA_X_LSB_ADDR (0X28)
 #define BNO055_GRAVITY_DATA_X_LSB_ADDR (0X2E)
 #define BNO055_ST_RESULT (0x36)
+#define BNO055_INT_STA_ADDR (0X37)
 
 /** Operation mode settings **/
 #define OPERATION_MODE_CONFIG (0x00)
@@ -44,6 +73,14 @@
 
 /** BNO055 power settings */
 #define POWER_MODE_NORMAL (0X00)
+#define POWER_MODE_LOWPOWER (0X01)
+#define POWER_MODE_SUSPEND (0X02)
+
+/** Interrupt bits, shared by INT_STA, INT_MSK and INT_EN */
+#define BNO055_INT_ACC_AM (0x40)
+
+/** SYS_TRIGGER bits */
+#define BNO055_SYS_TRIGGER_RST_INT (0x40)
 
 namespace IO = EVT::core::IO;
 
@@ -70,7 +107,8 @@ public:
     enum class BNO055Status {
         OK = 0,
         FAIL_INIT = 1,
-        FAIL_SELF_TEST = 2
+        FAIL_SELF_TEST = 2,
+        FAIL_CONFIG = 3
     };
 
     /**
@@ -144,7 +182,135 @@ public:
      */
     IO::I2C::I2CStatus getGravity(uint16_t& xBuffer, uint16_t& yBuffer, uint16_t& zBuffer);
 
+    /**
+     * Fetch the interrupt status register. Each set bit is an interrupt that has fired since the
+     * interrupts were last reset.
+     *
+     * @param[out] status the value of INT_STA, see the BNO055_INT_* bits.
+     *
+     * @return an i2c status reporting if the fetch worked or not.
+     */
+    IO::I2C::I2CStatus getInterruptStatus(uint8_t& status);
+
+    /**
+     * Clear the interrupt status register and release the interrupt pin.
+     *
+     * @return an i2c status reporting if the reset worked or not.
+     */
+    IO::I2C::I2CStatus resetInterrupts();
+
+    /**
+     * Stage a new value for one of the configuration registers. Nothing is sent to the chip
+     * until commitConfig() is called, so several changes can be staged and applied with a
+     * single trip through CONFIG mode.
+     *
+     * @param[in] page the register page the register lives on (BNO055_PAGE_0 or BNO055_PAGE_1).
+     * @param[in] reg the address of the register on that page.
+     * @param[in] value the value to stage for the register.
+     *
+     * @return FAIL_CONFIG if the register is not a shadowed configuration register, OK otherwise.
+     */
+    BNO055Status stageRegister(uint8_t page, uint8_t reg, uint8_t value);
+
+    /**
+     * Stage the operation mode the chip should be left in after the next commitConfig().
+     *
+     * @param[in] mode one of the OPERATION_MODE_* values.
+     */
+    void stageOperationMode(uint8_t mode);
+
+    /**
+     * Apply all staged configuration changes. The chip is switched into CONFIG mode once,
+     * only the registers whose staged value differs from the shadow copy are written
+     * (contiguous registers are merged into a single burst write), then the chip is
+     * returned to the staged operation mode on page 0.
+     *
+     * If nothing differs from the shadow copy this does not touch the bus at all.
+     *
+     * @return an i2c status reporting if the commit worked or not. On failure, the
+     * registers that were not written remain staged so the commit can be retried.
+     */
+    IO::I2C::I2CStatus commitConfig();
+
+    /**
+     * Drop all staged changes, reverting the staged values to the shadow copy and the staged operation
+     * mode to the last committed one. Commit afterwards to return the chip to that mode if a failed
+     * commit left it in CONFIG mode.
+     */
+    void discardConfig();
+
+    /**
+     * Get the last known value of a configuration register from the shadow copy.
+     * This does not communicate with the chip.
+     *
+     * @param[in] page the register page the register lives on.
+     * @param[in] reg the address of the register on that page.
+     * @param[out] value the shadowed value of the register.
+     *
+     * @return FAIL_CONFIG if the register is not a shadowed configuration register, OK otherwise.
+     */
+    BNO055Status getShadowRegister(uint8_t page, uint8_t reg, uint8_t& value);
+
+    /**
+     * Get the operation mode the chip is currently in, as tracked by the driver.
+     *
+     * @return one of the OPERATION_MODE_* values.
+     */
+    uint8_t getOperationMode();
+
 private:
+    /** Largest number of registers held in one shadow window */
+    static constexpr uint8_t MAX_SHADOW_WINDOW_SIZE = 24;
+
+    /** Number of shadow windows, one per register page */
+    static constexpr uint8_t NUM_SHADOW_WINDOWS = 2;
+
+    /**
+     * A contiguous range of configuration registers on a single page that the driver
+     * keeps a shadow copy of.
+     */
+    struct ShadowWindow {
+        /** The page the registers live on */
+        uint8_t page;
+        /** The address of the first register in the window */
+        uint8_t firstAddress;
+        /** The number of registers in the window */
+        uint8_t size;
+        /** Bit n set if register firstAddress + n may be written */
+        uint32_t writableMask;
+        /** Bit n set if the staged value of register firstAddress + n differs from the shadow */
+        uint32_t dirtyMask;
+        /** The last values known to be on the chip */
+        uint8_t values[MAX_SHADOW_WINDOW_SIZE];
+        /** The values to be written on the next commit */
+        uint8_t staged[MAX_SHADOW_WINDOW_SIZE];
+    };
+
+    /**
+     * Shadow copies of the page 0 (UNIT_SEL..AXIS_MAP_SIGN) and page 1 (ACC_CONFIG..GYR_AM_SET)
+     * configuration registers. OPR_MODE, PAGE_ID and SYS_TRIGGER are tracked separately and
+     * are never written through the shadow.
+     */
+    ShadowWindow shadowWindows[NUM_SHADOW_WINDOWS] = {
+        {BNO055_PAGE_0, BNO055_UNIT_SEL_ADDR, 8, 0b11101001, 0, {}, {}},
+        {BNO055_PAGE_1, BNO055_ACC_CONFIG_ADDR, 24, 0xFFFFBF, 0, {}, {}},
+    };
+
+    /** The register page the chip is currently on */
+    uint8_t currentPage = BNO055_PAGE_0;
+
+    /** The operation mode the chip is currently in */
+    uint8_t currentMode = OPERATION_MODE_CONFIG;
+
+    /** The operation mode to leave the chip in after the next commit */
+    uint8_t stagedMode = OPERATION_MODE_CONFIG;
+
+    /**
+     * The operation mode of the last successful commit. Unlike currentMode, this is never left as CONFIG by
+     * a commit that failed partway, so it is what discardConfig() returns to.
+     */
+    uint8_t operatingMode = OPERATION_MODE_CONFIG;
+
     /**
      * The i2c address for the BNO055.
      */
@@ -166,6 +332,82 @@ private:
      * @return an i2c status reporting if the fetch worked or not.
      */
     IO::I2C::I2CStatus fetchData(uint8_t lowestAddress, uint16_t& xBuffer, uint16_t& yBuffer, uint16_t& zBuffer);
+
+    /**
+     * Write a single byte to the BNO055, which sets the register pointer for the next read.
+     * Every bus access goes through the bus* functions so they are all timed by the profiler.
+     *
+     * @param[in] byte the byte to write.
+     *
+     * @return an i2c status reporting if the write worked or not.
+     */
+    IO::I2C::I2CStatus busWrite(uint8_t byte);
+
+    /**
+     * Write bytes to the BNO055. The first byte is the register to start writing at.
+     *
+     * @param[in] bytes the bytes to write.
+     * @param[in] length the number of bytes to write.
+     *
+     * @return an i2c status reporting if the write worked or not.
+     */
+    IO::I2C::I2CStatus busWrite(uint8_t* bytes, uint8_t length);
+
+    /**
+     * Read a single byte from the BNO055's current register.
+     *
+     * @param[out] byte a buffer to store the byte in.
+     *
+     * @return an i2c status reporting if the read worked or not.
+     */
+    IO::I2C::I2CStatus busRead(uint8_t& byte);
+
+    /**
+     * Read bytes from the BNO055, starting at its current register.
+     *
+     * @param[out] bytes a buffer to store the bytes in.
+     * @param[in] length the number of bytes to read.
+     *
+     * @return an i2c status reporting if the read worked or not.
+     */
+    IO::I2C::I2CStatus busRead(uint8_t* bytes, uint8_t length);
+
+    /**
+     * Find the shadow window and offset holding a configuration register.
+     *
+     * @param[in] page the register page the register lives on.
+     * @param[in] reg the address of the register on that page.
+     * @param[out] offset the offset of the register within the returned window.
+     *
+     * @return the window holding the register, or nullptr if it is not shadowed.
+     */
+    ShadowWindow* findShadowRegister(uint8_t page, uint8_t reg, uint8_t& offset);
+
+    /**
+     * Switch the chip to a register page, skipping the write if it is already on that page.
+     *
+     * @param[in] page the page to switch to.
+     *
+     * @return an i2c status reporting if the switch worked or not.
+     */
+    IO::I2C::I2CStatus selectPage(uint8_t page);
+
+    /**
+     * Switch the chip to an operation mode and wait the required switching time.
+     *
+     * @param[in] mode the operation mode to switch to.
+     *
+     * @return an i2c status reporting if the switch worked or not.
+     */
+    IO::I2C::I2CStatus writeOperationMode(uint8_t mode);
+
+    /**
+     * Read every shadow window back from the chip so the shadow copy matches the hardware.
+     * The chip must be in CONFIG mode. Leaves the chip on page 0.
+     *
+     * @return an i2c status reporting if the read worked or not.
+     */
+    IO::I2C::I2CStatus syncShadow();
 };
 
 }// namespace IMU
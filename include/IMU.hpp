@@ -1,6 +1,9 @@
 #pragma once
 
 #include <BNO055.hpp>
+#include <OrientationFilter.hpp>
+#include <PowerManager.hpp>
+#include <Profiler.hpp>
 #include <EVT/io/CANopen.hpp>
 #include <EVT/io/I2C.hpp>
 #include <EVT/io/UART.hpp>
@@ -21,12 +24,38 @@ public:
     /** The node ID is used to identify the device on the CAN network */
     static constexpr uint8_t NODE_ID = 9;
 
+    /** Number of TPDOs the IMU sends */
+    static constexpr uint8_t NUM_TPDOS = 4;
+
+    /** Event timer of each TPDO while active, in ms. TPDO 3 carries the on-MCU fusion output */
+    static constexpr uint16_t TPDO_PERIODS[NUM_TPDOS] = {50, 50, 50, 10};
+
+    /** Index of the TPDO that carries the on-MCU fusion output */
+    static constexpr uint8_t FUSION_TPDO = 3;
+
+    /** Event timer value that stops a TPDO from being sent */
+    static constexpr uint16_t TPDO_DISABLED = 0;
+
+    /** Event timer of every TPDO while parked, in ms */
+    static constexpr uint16_t PARKED_TPDO_PERIOD = 1000;
+
+    /** Gyroscope rate on any axis above which the IMU counts as moving, 16 LSB per dps */
+    static constexpr int16_t MOTION_THRESHOLD = 2 * 16;
+
+    /** Vehicle speed value for when no speed has been received */
+    static constexpr uint16_t SPEED_UNKNOWN = 0xFFFF;
+
     /**
      * Basic constructor for an IMU instance. It calls the initialization routine of the BNO055.
      *
+     * With on-MCU fusion enabled, the BNO055 is put into AMG mode with faster sensor bandwidths and
+     * the orientation is computed by an OrientationFilter instead of the BNO055's NDOF fusion.
+     * The BNO055 Euler values are not available in this mode.
+     *
      * @param[in] bno055 BNO instance to read data from
+     * @param[in] onboardFusion whether to run orientation fusion on the MCU
      */
-    explicit IMU(BNO055 bno055);
+    explicit IMU(BNO055 bno055, bool onboardFusion = false);
 
     /**
      * Gets the object dictionary
@@ -54,10 +83,74 @@ public:
      */
     void process();
 
+    /**
+     * Bring the IMU back to full rate if it is parked, and restart the idle timeout.
+     */
+    void wake();
+
+    /**
+     * Get the current power state of the IMU.
+     *
+     * @return the current power state.
+     */
+    PowerManager::PowerState getPowerState();
+
+    /**
+     * Get the event timer a TPDO should use in the current power state. The fusion TPDO is disabled
+     * when on-MCU fusion is off, since it would only carry zeros.
+     *
+     * @param[in] tpdo the index of the TPDO.
+     *
+     * @return the event timer in ms, or TPDO_DISABLED.
+     */
+    uint16_t getTPDOPeriod(uint8_t tpdo);
+
 private:
     /** The BNO055 sensor of the IMU */
     BNO055 bno055;
 
+    /** Whether orientation is being fused on the MCU instead of on the BNO055 */
+    bool onboardFusion;
+
+    /** The on-MCU orientation fusion engine */
+    OrientationFilter orientationFilter;
+
+    /** Profiler time of the last sample given to the orientation filter */
+    uint32_t lastFusionTime = 0;
+
+    /** Parks the BNO055 in low power mode when the bike isn't moving */
+    PowerManager powerManager;
+
+    /**
+    * 0. FUSION_LEAN - fusionValues[0], 1/16 degree per LSB
+    * 1. FUSION_PITCH - fusionValues[1], 1/16 degree per LSB
+    * 2. FUSION_YAW_RATE - fusionValues[2], 1/16 degree per second per LSB
+     */
+    uint16_t fusionValues[3] = {};
+
+    /**
+     * Forward speed of the bike in 0.01 m/s, or SPEED_UNKNOWN. Written over CANopen by whichever board knows the
+     * speed, and used by the on-MCU fusion to remove centripetal acceleration in corners.
+     */
+    uint16_t vehicleSpeed = SPEED_UNKNOWN;
+
+    /**
+     * Read raw gyroscope and accelerometer data and run one step of the on-MCU fusion.
+     */
+    void processFusion();
+
+    /**
+     * Restart the on-MCU fusion, so the next sample re-initializes the orientation from the accelerometer.
+     */
+    void resetFusion();
+
+    /**
+     * Check the latest gyroscope data for motion.
+     *
+     * @return whether any axis is rotating faster than MOTION_THRESHOLD.
+     */
+    bool isMoving();
+
     /**
     * 0. VECTOR_EULER_X - vectorXValues[0]
     * 1. VECTOR_GYROSCOPE_X - vectorXValues[1]
@@ -85,7 +178,7 @@ private:
     /**
      * Object Dictionary Size
      */
-    static constexpr uint16_t OBJECT_DICTIONARY_SIZE = 58;
+    static constexpr uint16_t OBJECT_DICTIONARY_SIZE = 153;
 
     /**
     * The object dictionary itself. Will be populated by this object during
@@ -100,9 +193,11 @@ private:
         IDENTITY_OBJECT_1018,
         SDO_CONFIGURATION_1200,
 
-        TRANSMIT_PDO_SETTINGS_OBJECT_18XX(0x00, TRANSMIT_PDO_TRIGGER_TIMER, TRANSMIT_PDO_INHIBIT_TIME_DISABLE, 50),
-        TRANSMIT_PDO_SETTINGS_OBJECT_18XX(0x01, TRANSMIT_PDO_TRIGGER_TIMER, TRANSMIT_PDO_INHIBIT_TIME_DISABLE, 50),
-        TRANSMIT_PDO_SETTINGS_OBJECT_18XX(0x02, TRANSMIT_PDO_TRIGGER_TIMER, TRANSMIT_PDO_INHIBIT_TIME_DISABLE, 50),
+        TRANSMIT_PDO_SETTINGS_OBJECT_18XX(0x00, TRANSMIT_PDO_TRIGGER_TIMER, TRANSMIT_PDO_INHIBIT_TIME_DISABLE, TPDO_PERIODS[0]),
+        TRANSMIT_PDO_SETTINGS_OBJECT_18XX(0x01, TRANSMIT_PDO_TRIGGER_TIMER, TRANSMIT_PDO_INHIBIT_TIME_DISABLE, TPDO_PERIODS[1]),
+        TRANSMIT_PDO_SETTINGS_OBJECT_18XX(0x02, TRANSMIT_PDO_TRIGGER_TIMER, TRANSMIT_PDO_INHIBIT_TIME_DISABLE, TPDO_PERIODS[2]),
+        // onboardFusion is declared before the object dictionary, so it is already set here
+        TRANSMIT_PDO_SETTINGS_OBJECT_18XX(0x03, TRANSMIT_PDO_TRIGGER_TIMER, TRANSMIT_PDO_INHIBIT_TIME_DISABLE, onboardFusion ? TPDO_PERIODS[3] : TPDO_DISABLED),
 
         TRANSMIT_PDO_MAPPING_START_KEY_1AXX(0x00, 0x04),
         TRANSMIT_PDO_MAPPING_ENTRY_1AXX(0x00, 1, PDO_MAPPING_UNSIGNED16),
@@ -122,6 +217,11 @@ private:
         TRANSMIT_PDO_MAPPING_ENTRY_1AXX(0x02, 3, PDO_MAPPING_UNSIGNED16),
         TRANSMIT_PDO_MAPPING_ENTRY_1AXX(0x02, 4, PDO_MAPPING_UNSIGNED16),
 
+        TRANSMIT_PDO_MAPPING_START_KEY_1AXX(0x03, 0x03),
+        TRANSMIT_PDO_MAPPING_ENTRY_1AXX(0x03, 1, PDO_MAPPING_UNSIGNED16),
+        TRANSMIT_PDO_MAPPING_ENTRY_1AXX(0x03, 2, PDO_MAPPING_UNSIGNED16),
+        TRANSMIT_PDO_MAPPING_ENTRY_1AXX(0x03, 3, PDO_MAPPING_UNSIGNED16),
+
         // User defined data, this will be where we put elements that can be
         // accessed via SDO and depending on configuration PDO
         DATA_LINK_START_KEY_21XX(0x00, 0x04),
@@ -142,6 +242,106 @@ private:
         DATA_LINK_21XX(0x02, 0x03, CO_TUNSIGNED16, &vectorZValues[2]),
         DATA_LINK_21XX(0x02, 0x04, CO_TUNSIGNED16, &vectorZValues[3]),
 
+        // On-MCU fusion outputs, and the vehicle speed input in sub-index 4
+        DATA_LINK_START_KEY_21XX(0x03, 0x04),
+        DATA_LINK_21XX(0x03, 0x01, CO_TUNSIGNED16, &fusionValues[0]),
+        DATA_LINK_21XX(0x03, 0x02, CO_TUNSIGNED16, &fusionValues[1]),
+        DATA_LINK_21XX(0x03, 0x03, CO_TUNSIGNED16, &fusionValues[2]),
+        DATA_LINK_21XX(0x03, 0x04, CO_TUNSIGNED16, &vehicleSpeed),
+
+        // Profiling histograms, 0x2110 is I2C transactions, 0x2111 is IMU::process(), 0x2112 is the CANopen
+        // stack. Sub-indices 1-16 are the log2 buckets (see Profiler) and 17 is the maximum, all in ticks.
+        // Writing a non-zero value to 0x2113 sub-index 1 clears them. 0x2114 is OrientationFilter::update().
+        DATA_LINK_START_KEY_21XX(0x10, 0x11),
+        DATA_LINK_21XX(0x10, 0x01, CO_TUNSIGNED32, &PROFILER.histograms[0].buckets[0]),
+        DATA_LINK_21XX(0x10, 0x02, CO_TUNSIGNED32, &PROFILER.histograms[0].buckets[1]),
+        DATA_LINK_21XX(0x10, 0x03, CO_TUNSIGNED32, &PROFILER.histograms[0].buckets[2]),
+        DATA_LINK_21XX(0x10, 0x04, CO_TUNSIGNED32, &PROFILER.histograms[0].buckets[3]),
+        DATA_LINK_21XX(0x10, 0x05, CO_TUNSIGNED32, &PROFILER.histograms[0].buckets[4]),
+        DATA_LINK_21XX(0x10, 0x06, CO_TUNSIGNED32, &PROFILER.histograms[0].buckets[5]),
+        DATA_LINK_21XX(0x10, 0x07, CO_TUNSIGNED32, &PROFILER.histograms[0].buckets[6]),
+        DATA_LINK_21XX(0x10, 0x08, CO_TUNSIGNED32, &PROFILER.histograms[0].buckets[7]),
+        DATA_LINK_21XX(0x10, 0x09, CO_TUNSIGNED32, &PROFILER.histograms[0].buckets[8]),
+        DATA_LINK_21XX(0x10, 0x0A, CO_TUNSIGNED32, &PROFILER.histograms[0].buckets[9]),
+        DATA_LINK_21XX(0x10, 0x0B, CO_TUNSIGNED32, &PROFILER.histograms[0].buckets[10]),
+        DATA_LINK_21XX(0x10, 0x0C, CO_TUNSIGNED32, &PROFILER.histograms[0].buckets[11]),
+        DATA_LINK_21XX(0x10, 0x0D, CO_TUNSIGNED32, &PROFILER.histograms[0].buckets[12]),
+        DATA_LINK_21XX(0x10, 0x0E, CO_TUNSIGNED32, &PROFILER.histograms[0].buckets[13]),
+        DATA_LINK_21XX(0x10, 0x0F, CO_TUNSIGNED32, &PROFILER.histograms[0].buckets[14]),
+        DATA_LINK_21XX(0x10, 0x10, CO_TUNSIGNED32, &PROFILER.histograms[0].buckets[15]),
+        DATA_LINK_21XX(0x10, 0x11, CO_TUNSIGNED32, &PROFILER.histograms[0].max),
+
+        DATA_LINK_START_KEY_21XX(0x11, 0x11),
+        DATA_LINK_21XX(0x11, 0x01, CO_TUNSIGNED32, &PROFILER.histograms[1].buckets[0]),
+        DATA_LINK_21XX(0x11, 0x02, CO_TUNSIGNED32, &PROFILER.histograms[1].buckets[1]),
+        DATA_LINK_21XX(0x11, 0x03, CO_TUNSIGNED32, &PROFILER.histograms[1].buckets[2]),
+        DATA_LINK_21XX(0x11, 0x04, CO_TUNSIGNED32, &PROFILER.histograms[1].buckets[3]),
+        DATA_LINK_21XX(0x11, 0x05, CO_TUNSIGNED32, &PROFILER.histograms[1].buckets[4]),
+        DATA_LINK_21XX(0x11, 0x06, CO_TUNSIGNED32, &PROFILER.histograms[1].buckets[5]),
+        DATA_LINK_21XX(0x11, 0x07, CO_TUNSIGNED32, &PROFILER.histograms[1].buckets[6]),
+        DATA_LINK_21XX(0x11, 0x08, CO_TUNSIGNED32, &PROFILER.histograms[1].buckets[7]),
+        DATA_LINK_21XX(0x11, 0x09, CO_TUNSIGNED32, &PROFILER.histograms[1].buckets[8]),
+        DATA_LINK_21XX(0x11, 0x0A, CO_TUNSIGNED32, &PROFILER.histograms[1].buckets[9]),
+        DATA_LINK_21XX(0x11, 0x0B, CO_TUNSIGNED32, &PROFILER.histograms[1].buckets[10]),
+        DATA_LINK_21XX(0x11, 0x0C, CO_TUNSIGNED32, &PROFILER.histograms[1].buckets[11]),
+        DATA_LINK_21XX(0x11, 0x0D, CO_TUNSIGNED32, &PROFILER.histograms[1].buckets[12]),
+        DATA_LINK_21XX(0x11, 0x0E, CO_TUNSIGNED32, &PROFILER.histograms[1].buckets[13]),
+        DATA_LINK_21XX(0x11, 0x0F, CO_TUNSIGNED32, &PROFILER.histograms[1].buckets[14]),
+        DATA_LINK_21XX(0x11, 0x10, CO_TUNSIGNED32, &PROFILER.histograms[1].buckets[15]),
+        DATA_LINK_21XX(0x11, 0x11, CO_TUNSIGNED32, &PROFILER.histograms[1].max),
+
+        DATA_LINK_START_KEY_21XX(0x12, 0x11),
+        DATA_LINK_21XX(0x12, 0x01, CO_TUNSIGNED32, &PROFILER.histograms[2].buckets[0]),
+        DATA_LINK_21XX(0x12, 0x02, CO_TUNSIGNED32, &PROFILER.histograms[2].buckets[1]),
+        DATA_LINK_21XX(0x12, 0x03, CO_TUNSIGNED32, &PROFILER.histograms[2].buckets[2]),
+        DATA_LINK_21XX(0x12, 0x04, CO_TUNSIGNED32, &PROFILER.histograms[2].buckets[3]),
+        DATA_LINK_21XX(0x12, 0x05, CO_TUNSIGNED32, &PROFILER.histograms[2].buckets[4]),
+        DATA_LINK_21XX(0x12, 0x06, CO_TUNSIGNED32, &PROFILER.histograms[2].buckets[5]),
+        DATA_LINK_21XX(0x12, 0x07, CO_TUNSIGNED32, &PROFILER.histograms[2].buckets[6]),
+        DATA_LINK_21XX(0x12, 0x08, CO_TUNSIGNED32, &PROFILER.histograms[2].buckets[7]),
+        DATA_LINK_21XX(0x12, 0x09, CO_TUNSIGNED32, &PROFILER.histograms[2].buckets[8]),
+        DATA_LINK_21XX(0x12, 0x0A, CO_TUNSIGNED32, &PROFILER.histograms[2].buckets[9]),
+        DATA_LINK_21XX(0x12, 0x0B, CO_TUNSIGNED32, &PROFILER.histograms[2].buckets[10]),
+        DATA_LINK_21XX(0x12, 0x0C, CO_TUNSIGNED32, &PROFILER.histograms[2].buckets[11]),
+        DATA_LINK_21XX(0x12, 0x0D, CO_TUNSIGNED32, &PROFILER.histograms[2].buckets[12]),
+        DATA_LINK_21XX(0x12, 0x0E, CO_TUNSIGNED32, &PROFILER.histograms[2].buckets[13]),
+        DATA_LINK_21XX(0x12, 0x0F, CO_TUNSIGNED32, &PROFILER.histograms[2].buckets[14]),
+        DATA_LINK_21XX(0x12, 0x10, CO_TUNSIGNED32, &PROFILER.histograms[2].buckets[15]),
+        DATA_LINK_21XX(0x12, 0x11, CO_TUNSIGNED32, &PROFILER.histograms[2].max),
+
+        DATA_LINK_START_KEY_21XX(0x13, 0x01),
+        DATA_LINK_21XX(0x13, 0x01, CO_TUNSIGNED8, &PROFILER.resetRequest),
+
+        DATA_LINK_START_KEY_21XX(0x14, 0x11),
+        DATA_LINK_21XX(0x14, 0x01, CO_TUNSIGNED32, &PROFILER.histograms[3].buckets[0]),
+        DATA_LINK_21XX(0x14, 0x02, CO_TUNSIGNED32, &PROFILER.histograms[3].buckets[1]),
+        DATA_LINK_21XX(0x14, 0x03, CO_TUNSIGNED32, &PROFILER.histograms[3].buckets[2]),
+        DATA_LINK_21XX(0x14, 0x04, CO_TUNSIGNED32, &PROFILER.histograms[3].buckets[3]),
+        DATA_LINK_21XX(0x14, 0x05, CO_TUNSIGNED32, &PROFILER.histograms[3].buckets[4]),
+        DATA_LINK_21XX(0x14, 0x06, CO_TUNSIGNED32, &PROFILER.histograms[3].buckets[5]),
+        DATA_LINK_21XX(0x14, 0x07, CO_TUNSIGNED32, &PROFILER.histograms[3].buckets[6]),
+        DATA_LINK_21XX(0x14, 0x08, CO_TUNSIGNED32, &PROFILER.histograms[3].buckets[7]),
+        DATA_LINK_21XX(0x14, 0x09, CO_TUNSIGNED32, &PROFILER.histograms[3].buckets[8]),
+        DATA_LINK_21XX(0x14, 0x0A, CO_TUNSIGNED32, &PROFILER.histograms[3].buckets[9]),
+        DATA_LINK_21XX(0x14, 0x0B, CO_TUNSIGNED32, &PROFILER.histograms[3].buckets[10]),
+        DATA_LINK_21XX(0x14, 0x0C, CO_TUNSIGNED32, &PROFILER.histograms[3].buckets[11]),
+        DATA_LINK_21XX(0x14, 0x0D, CO_TUNSIGNED32, &PROFILER.histograms[3].buckets[12]),
+        DATA_LINK_21XX(0x14, 0x0E, CO_TUNSIGNED32, &PROFILER.histograms[3].buckets[13]),
+        DATA_LINK_21XX(0x14, 0x0F, CO_TUNSIGNED32, &PROFILER.histograms[3].buckets[14]),
+        DATA_LINK_21XX(0x14, 0x10, CO_TUNSIGNED32, &PROFILER.histograms[3].buckets[15]),
+        DATA_LINK_21XX(0x14, 0x11, CO_TUNSIGNED32, &PROFILER.histograms[3].max),
+
+        // Power management. 1 is the idle timeout in s (0 disables parking), writing non-zero to 2 wakes the IMU,
+        // 3 is the PowerState, 4 and 5 are the ms spent active and parked, and 6 is the last wake up time in ms.
+        // 3 to 6 are copies, so writing them has no effect.
+        DATA_LINK_START_KEY_21XX(0x20, 0x06),
+        DATA_LINK_21XX(0x20, 0x01, CO_TUNSIGNED16, &powerManager.idleTimeout),
+        DATA_LINK_21XX(0x20, 0x02, CO_TUNSIGNED8, &powerManager.wakeRequest),
+        DATA_LINK_21XX(0x20, 0x03, CO_TUNSIGNED8, &powerManager.publishedState),
+        DATA_LINK_21XX(0x20, 0x04, CO_TUNSIGNED32, &powerManager.publishedResidency[0]),
+        DATA_LINK_21XX(0x20, 0x05, CO_TUNSIGNED32, &powerManager.publishedResidency[1]),
+        DATA_LINK_21XX(0x20, 0x06, CO_TUNSIGNED32, &powerManager.publishedWakeLatency),
+
         // End of dictionary marker
         CO_OBJ_DICT_ENDMARK,
     };
@@ -0,0 +1,132 @@
+#ifndef IMU_ORIENTATIONFILTER_HPP
+#define IMU_ORIENTATIONFILTER_HPP
+
+#include <cstdint>
+
+namespace IMU {
+
+/**
+ * A Mahony complementary filter that fuses raw gyroscope and accelerometer data into an orientation
+ * estimate on the MCU. This is used in place of the BNO055's internal fusion, which is limited to 100 Hz,
+ * when lower latency is needed (e.g. for traction control).
+ *
+ * All math is single precision so it runs on the Cortex-M4 FPU. Apart from the one time initialization on the
+ * first update, each update is straight-line code with a fixed number of operations, so its cycle cost does not
+ * depend on the input data. The getters are not: getLean() and getPitch() call atan2f and asinf, whose run
+ * time depends on the argument.
+ *
+ * Frames follow the BNO055 axes: lean is rotation about X, pitch is rotation about Y, and yaw rate is the
+ * angular velocity about the vertical (gravity) axis. X must point forward for the speed compensation.
+ *
+ * The accelerometer only measures gravity when the bike isn't accelerating. In a corner it also measures the
+ * centripetal acceleration, which on a bike in a steady turn exactly cancels the lean, so an uncorrected filter
+ * would slowly pull the lean back to 0 through the whole corner. When the vehicle speed is known, the centripetal
+ * acceleration is computed from the speed and the measured angular velocity and removed. Whatever acceleration
+ * remains (braking, bumps, or turns without a speed) is handled by weakening the accelerometer correction as the
+ * measured acceleration moves away from 1 g, and, without a speed, as the yaw rate grows. While the correction is off
+ * the estimate follows the gyroscope alone, so without a speed, long stretches of continuous turning drift with the
+ * gyroscope bias.
+ */
+class OrientationFilter {
+public:
+    /**
+     * Create a filter with the given feedback gains.
+     *
+     * @param[in] kp proportional gain, how quickly the accelerometer corrects gyroscope drift.
+     * @param[in] ki integral gain, how quickly the gyroscope bias estimate adapts.
+     */
+    explicit OrientationFilter(float kp = 2.0f, float ki = 0.005f);
+
+    /** Standard gravity, m/s^2 */
+    static constexpr float GRAVITY = 9.80665f;
+
+    /**
+     * Deviation of the acceleration magnitude from 1 g, as a fraction of g, at which the accelerometer
+     * correction is turned off completely. The correction is scaled down linearly up to this point.
+     */
+    static constexpr float ACCEL_GATE = 0.1f;
+
+    /**
+     * Yaw rate in rad/s at which the accelerometer correction is turned off completely when the speed is
+     * unknown. The correction is scaled down linearly up to this point.
+     */
+    static constexpr float YAW_RATE_GATE = 0.05f;
+
+    /** Speed value for when the vehicle speed is unknown */
+    static constexpr float SPEED_UNKNOWN = -1.0f;
+
+    /**
+     * Reset the filter so the next update re-initializes the orientation from the accelerometer.
+     */
+    void reset();
+
+    /**
+     * Set the forward speed of the vehicle, used to remove centripetal acceleration from the accelerometer
+     * data. The speed starts out unknown, in which case turns are handled by the yaw rate gate instead.
+     *
+     * @param[in] speed the speed along X in m/s, or SPEED_UNKNOWN.
+     */
+    void setSpeed(float speed);
+
+    /**
+     * Run one filter step.
+     *
+     * @param[in] gx gyroscope X in rad/s.
+     * @param[in] gy gyroscope Y in rad/s.
+     * @param[in] gz gyroscope Z in rad/s.
+     * @param[in] ax accelerometer X in m/s^2.
+     * @param[in] ay accelerometer Y in m/s^2.
+     * @param[in] az accelerometer Z in m/s^2.
+     * @param[in] dt time since the previous update in seconds.
+     */
+    void update(float gx, float gy, float gz, float ax, float ay, float az, float dt);
+
+    /**
+     * Get the lean (roll) angle.
+     *
+     * @return the rotation about X in radians.
+     */
+    float getLean();
+
+    /**
+     * Get the pitch angle.
+     *
+     * @return the rotation about Y in radians.
+     */
+    float getPitch();
+
+    /**
+     * Get the yaw rate about the vertical axis, with the estimated gyroscope bias removed. The accelerometer
+     * can't observe bias about the vertical axis, so that part of the bias is only removed as far as leaning
+     * has exposed it.
+     *
+     * @return the yaw rate in rad/s.
+     */
+    float getYawRate();
+
+private:
+    /** Proportional feedback gain */
+    float kp;
+
+    /** Integral feedback gain */
+    float ki;
+
+    /** Forward speed in m/s, or SPEED_UNKNOWN */
+    float speed = SPEED_UNKNOWN;
+
+    /** Whether the orientation has been initialized from the accelerometer */
+    bool initialized = false;
+
+    /** Orientation quaternion, w, x, y, z */
+    float q0 = 1.0f, q1 = 0.0f, q2 = 0.0f, q3 = 0.0f;
+
+    /** Integral of the orientation error, which converges to the negative of the gyroscope bias */
+    float integralX = 0.0f, integralY = 0.0f, integralZ = 0.0f;
+
+    /** Yaw rate computed during the last update */
+    float yawRate = 0.0f;
+};
+
+}// namespace IMU
+
+#endif//IMU_ORIENTATIONFILTER_HPP
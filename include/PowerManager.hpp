@@ -0,0 +1,162 @@
+#ifndef IMU_POWERMANAGER_HPP
+#define IMU_POWERMANAGER_HPP
+
+#include <BNO055.hpp>
+#include <cstdint>
+
+namespace IMU {
+
+/**
+ * Puts the BNO055 into low power mode while the bike is parked and brings it back to full rate
+ * when it moves again.
+ *
+ * While active, the IMU reports whether it saw motion on every process() call. Once no motion has been
+ * seen for idleTimeout seconds, the BNO055 is switched to low power mode with its any-motion interrupt
+ * enabled. While parked, the interrupt status is polled every PARKED_POLL_PERIOD ms and the BNO055 is returned
+ * to normal power mode as soon as it reports motion, or when a wake up is requested over CANopen or by the
+ * application.
+ *
+ * The time spent in each state is kept so average current can be estimated from the datasheet currents.
+ * All bookkeeping uses time::millis(), which keeps counting while the MCU sleeps in idle().
+ */
+class PowerManager {
+public:
+    /** The power states of the IMU */
+    enum class PowerState {
+        ACTIVE = 0,
+        PARKED = 1
+    };
+
+    /** Number of power states */
+    static constexpr uint8_t NUM_POWER_STATES = 2;
+
+    /** Default time without motion before parking, in seconds */
+    static constexpr uint16_t DEFAULT_IDLE_TIMEOUT = 300;
+
+    /**
+     * Any-motion threshold used to wake up, in accelerometer any-motion LSB (7.81 mg at the 4 G
+     * range used by the fusion modes).
+     */
+    static constexpr uint8_t ANY_MOTION_THRESHOLD = 10;
+
+    /** Idle timeout value that disables parking */
+    static constexpr uint16_t PARKING_DISABLED = 0;
+
+    /**
+     * Time between interrupt status polls while parked, in ms. The main loop keeps running at the SysTick
+     * rate while parked, so this keeps it from reading the BNO055 on every pass. It adds up to this much to
+     * the time taken to notice motion.
+     */
+    static constexpr uint32_t PARKED_POLL_PERIOD = 100;
+
+    /**
+     * Create a power manager for a BNO055. The BNO055 must already be set up and active.
+     *
+     * @param[in] bno055 the BNO055 to manage.
+     */
+    explicit PowerManager(BNO055& bno055);
+
+    /**
+     * Update the power state. Must be called regularly from the main loop.
+     *
+     * @param[in] moving whether the latest sensor data showed significant motion. Ignored while parked.
+     */
+    void process(bool moving);
+
+    /**
+     * Return to the active state if parked, and restart the idle timeout. If the BNO055 can't be returned
+     * to normal power, the IMU stays parked and the wake up is retried on every process() call.
+     */
+    void wake();
+
+    /**
+     * Get the current power state.
+     *
+     * @return the current power state.
+     */
+    PowerState getState();
+
+    /**
+     * Get the total time spent in a power state.
+     *
+     * @param[in] powerState the state to get the time for.
+     *
+     * @return the time spent in the state, in ms.
+     */
+    uint32_t getResidency(PowerState powerState);
+
+    /**
+     * Get how long the last wake up took to bring the BNO055 back to normal power.
+     *
+     * @return the wake up time in ms.
+     */
+    uint32_t getWakeLatency();
+
+    /**
+     * Let the MCU sleep until the next interrupt. The 1 kHz SysTick interrupt ends the sleep every
+     * millisecond, so this only saves the CPU time the loop would otherwise spin for, and the main loop
+     * keeps running up to 1000 times a second.
+     */
+    static void idle();
+
+    /** Time without motion before parking, in seconds, or PARKING_DISABLED. Writable over CANopen */
+    uint16_t idleTimeout = DEFAULT_IDLE_TIMEOUT;
+
+    /** Set to a non-zero value over CANopen to request a wake up */
+    uint8_t wakeRequest = 0;
+
+    /**
+     * Copies of the state, residency and wake up time published to the object dictionary. They are
+     * overwritten on every process() call and never read back, so writes to them over CANopen have no effect.
+     */
+    uint8_t publishedState = static_cast<uint8_t>(PowerState::ACTIVE);
+    uint32_t publishedResidency[NUM_POWER_STATES] = {};
+    uint32_t publishedWakeLatency = 0;
+
+private:
+    /** The BNO055 being managed */
+    BNO055& bno055;
+
+    /** The current power state */
+    PowerState state = PowerState::ACTIVE;
+
+    /** Total time spent in each power state in ms, indexed by PowerState */
+    uint32_t residency[NUM_POWER_STATES] = {};
+
+    /** How long the last wake up took, in ms */
+    uint32_t wakeLatency = 0;
+
+    /** time::millis() of the last process() call */
+    uint32_t lastTime;
+
+    /** time::millis() of the last interrupt status poll while parked */
+    uint32_t lastPollTime = 0;
+
+    /** How long no motion has been seen for, in ms */
+    uint32_t stillTime = 0;
+
+    /** Whether a failed park or wake up left the BNO055 to be returned to normal power */
+    bool restorePending = false;
+
+    /**
+     * Copy the current state, residency and wake up time to the published copies.
+     */
+    void publish();
+
+    /**
+     * Switch the BNO055 into low power mode with the any-motion interrupt enabled.
+     */
+    void park();
+
+    /**
+     * Return the BNO055 to normal power mode with the any-motion interrupt disabled and its operating
+     * mode restored, dropping anything a failed commit left staged.
+     *
+     * @return the status of the commit.
+     */
+    IO::I2C::I2CStatus restoreNormalPower();
+};
+
+}// namespace IMU
+
+#endif//IMU_POWERMANAGER_HPP
@@ -0,0 +1,124 @@
+#ifndef IMU_PROFILER_HPP
+#define IMU_PROFILER_HPP
+
+#include <cstdint>
+
+namespace IMU {
+
+/**
+ * Always-on, low-overhead timing instrumentation. Each probe keeps a histogram of how long the
+ * code it surrounds took, which is exposed over CANopen so timing problems can be diagnosed in the
+ * field without a debugger.
+ *
+ * On target, times are in CPU cycles from the DWT cycle counter. On the host, times are in
+ * nanoseconds from the monotonic clock, so the same probes work in simulation.
+ *
+ * Histogram buckets are logarithmic. Bucket 0 counts times below 2^BUCKET_BASE ticks, bucket n counts
+ * times in [2^(BUCKET_BASE + n - 1), 2^(BUCKET_BASE + n)), and the last bucket also counts everything longer.
+ */
+class Profiler {
+public:
+    /** The code sections that are timed */
+    enum class Probe {
+        I2C_TRANSACTION = 0,
+        IMU_PROCESS = 1,
+        CANOPEN_PROCESS = 2,
+        FUSION_UPDATE = 3
+    };
+
+    /** Number of probes */
+    static constexpr uint8_t NUM_PROBES = 4;
+
+    /** Number of buckets in each histogram */
+    static constexpr uint8_t NUM_BUCKETS = 16;
+
+    /** Log2 of the upper bound of the first bucket, 256 ticks */
+    static constexpr uint8_t BUCKET_BASE = 8;
+
+    /**
+     * The timing data for one probe. Kept in fixed RAM so it can be linked directly into the
+     * object dictionary.
+     */
+    struct Histogram {
+        /** Number of samples that landed in each bucket */
+        uint32_t buckets[NUM_BUCKETS];
+        /** Longest time seen, in ticks */
+        uint32_t max;
+    };
+
+    /**
+     * Enables the cycle counter on target.
+     */
+    Profiler();
+
+    /**
+     * Get the current time.
+     *
+     * @return the current time in ticks. This wraps around, so only differences are meaningful.
+     */
+    static uint32_t now();
+
+    /**
+     * Get the rate the clock returned by now() runs at.
+     *
+     * @return the number of ticks in one millisecond.
+     */
+    static uint32_t ticksPerMillisecond();
+
+    /**
+     * Record the time since a start time in a probe's histogram.
+     *
+     * @param[in] probe the probe to record the sample for.
+     * @param[in] start the time the probe started at, from now().
+     */
+    void record(Probe probe, uint32_t start);
+
+    /**
+     * Clear every histogram.
+     */
+    void reset();
+
+    /**
+     * Clear every histogram if a reset has been requested over CANopen. This should be called
+     * regularly from the main loop.
+     */
+    void processResetRequest();
+
+    /** Histograms for every probe, indexed by Probe */
+    Histogram histograms[NUM_PROBES] = {};
+
+    /** Set to a non-zero value over CANopen to request a reset of the histograms */
+    uint8_t resetRequest = 0;
+};
+
+/**
+ * Times the scope it is declared in and records it in the global profiler when it goes out of scope.
+ */
+class ScopedProbe {
+public:
+    /**
+     * Start timing.
+     *
+     * @param[in] probe the probe to record the time for.
+     */
+    explicit ScopedProbe(Profiler::Probe probe);
+
+    /**
+     * Stop timing and record the sample.
+     */
+    ~ScopedProbe();
+
+private:
+    /** The probe to record the time for */
+    Profiler::Probe probe;
+
+    /** The time the scope was entered */
+    uint32_t start;
+};
+
+/** The global profiler used by every probe */
+extern Profiler PROFILER;
+
+}// namespace IMU
+
+#endif//IMU_PROFILER_HPP
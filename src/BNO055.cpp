@@ -8,18 +8,22 @@ IMU::BNO055::BNO055Status IMU::BNO055::setup() {
 
     log::LOGGER.log(log::Logger::LogLevel::INFO, "Starting Initialization...\r\n");
 
+    // If the MCU was reset partway through a configuration commit, the BNO055 may still be powered on register
+    // page 1, where OPR_MODE and CHIP_ID can't be read. Select page 0 before reading anything.
+    uint8_t pageBytes[2] = {BNO055_PAGE_ID_ADDR, BNO055_PAGE_0};
+
     // We check that BNO055's i2c is activated already. If it is, we check if it is in operational mode.
     // If it is in operational mode, we will manually trigger the board reset.
-    if (i2c.write(i2cAddress, 0x00) == IO::I2C::I2CStatus::OK) {
+    if (busWrite(pageBytes, 2) == IO::I2C::I2CStatus::OK) {
         uint8_t currMode;
-        i2c.write(i2cAddress, BNO055_OPR_MODE_ADDR);
-        i2c.read(i2cAddress, &currMode);
+        busWrite(BNO055_OPR_MODE_ADDR);
+        busRead(currMode);
         if (currMode != OPERATION_MODE_CONFIG) {
             log::LOGGER.log(log::Logger::LogLevel::INFO, "Device is not in configuration mode, resetting device.");
             // We trigger a POR system reset. This resets the device and brings it off the i2c network for period of time.
             // Resetting also restores optimum values for the device to enter sleep or wake up. (section 3.2.2).
             uint8_t resetBytes[2] = {BNO055_SYS_TRIGGER_ADDR, 0x20};// RST_SYS is bit 5 of the SYS_TRIGGER
-            i2c.write(i2cAddress, resetBytes, 2);
+            busWrite(resetBytes, 2);
         }
     }
 
@@ -30,19 +34,19 @@ IMU::BNO055::BNO055Status IMU::BNO055::setup() {
     // Check if i2c returns a detected device and reports a successful connection. Read the ID from chip id register (0x00)
     // this is to make sure we are connected to the device
     uint8_t id = 0;
-    if (i2c.write(i2cAddress, 0x00) != IO::I2C::I2CStatus::OK) {
+    if (busWrite(0x00) != IO::I2C::I2CStatus::OK) {
         log::LOGGER.log(log::Logger::LogLevel::INFO, "Failed to detect IMU device with i2c and will quit initialization\r\n");
         return BNO055::BNO055Status::FAIL_INIT;
     }
     log::LOGGER.log(log::Logger::LogLevel::INFO, "Device should be booted now... Checking if we can read...\r\n");
-    i2c.read(i2cAddress, &id);
+    busRead(id);
     log::LOGGER.log(log::Logger::LogLevel::INFO, "ID Read 0x%x\r\n", id);
     if (id != BNO055_ID) {
         log::LOGGER.log(log::Logger::LogLevel::ERROR, "Failed first initialization... Trying again.\r\n");
 
         time::wait(1000);           // Hold on for boot
-        i2c.write(i2cAddress, 0x00);// keep reading id;
-        i2c.read(i2cAddress, &id);
+        busWrite(0x00);// keep reading id;
+        busRead(id);
 
         if (id != BNO055_ID) {
             log::LOGGER.log(log::Logger::LogLevel::ERROR, "Failed to initialize the IMU. Quitting initialization.\r\n");
@@ -58,8 +62,8 @@ IMU::BNO055::BNO055Status IMU::BNO055::setup() {
     uint8_t result;
     // We read the ST_RESULT register that the startup self-test updates once completed.
     // The self-test checks that all sensors are functional.
-    i2c.write(i2cAddress, BNO055_ST_RESULT);
-    i2c.read(i2cAddress, &result);
+    busWrite(BNO055_ST_RESULT);
+    busRead(result);
     // All four LSB bits of result should be 1 for successful test
     if ((result & 0x0F) != 0x0F) {
         log::LOGGER.log(log::Logger::LogLevel::ERROR, "Self-test failed. Quitting initialization.\r\n");
@@ -68,12 +72,23 @@ IMU::BNO055::BNO055Status IMU::BNO055::setup() {
         log::LOGGER.log(log::Logger::LogLevel::INFO, "Self-test passed, all sensors and microcontroller are functioning.\r\n");
     }
 
+    // The device is in CONFIG mode on page 0 after boot. Read the configuration registers back so the shadow
+    // copy matches the hardware, which lets later commits skip registers that are already correct.
+    currentPage = BNO055_PAGE_0;
+    currentMode = OPERATION_MODE_CONFIG;
+    if (syncShadow() != IO::I2C::I2CStatus::OK) {
+        log::LOGGER.log(log::Logger::LogLevel::ERROR, "Failed to read configuration registers. Quitting initialization.\r\n");
+        return BNO055::BNO055Status::FAIL_CONFIG;
+    }
+
     // Set the config mode to an operation mode that will report data. All of the values for this can be found in the datasheet.
     // NDOF turns on all sensors on absolute orientation.
     log::LOGGER.log(log::Logger::LogLevel::INFO, "Set config mode to all data.\r\n");
-    uint8_t config2Bytes[2] = {BNO055_OPR_MODE_ADDR, OPERATION_MODE_NDOF};
-    i2c.write(i2cAddress, config2Bytes, 2);
-    time::wait(20);
+    stageOperationMode(OPERATION_MODE_NDOF);
+    if (commitConfig() != IO::I2C::I2CStatus::OK) {
+        log::LOGGER.log(log::Logger::LogLevel::ERROR, "Failed to set operation mode. Quitting initialization.\r\n");
+        return BNO055::BNO055Status::FAIL_CONFIG;
+    }
 
     // If everything above worked, the device has successfully booted.
     log::LOGGER.log(log::Logger::LogLevel::INFO, "System successfully booted!\r\n");
@@ -100,18 +115,33 @@ IO::I2C::I2CStatus IMU::BNO055::getGravity(uint16_t& xBuffer, uint16_t& yBuffer,
     return fetchData(BNO055_GRAVITY_DATA_X_LSB_ADDR, xBuffer, yBuffer, zBuffer);
 }
 
+IO::I2C::I2CStatus IMU::BNO055::getInterruptStatus(uint8_t& status) {
+    IO::I2C::I2CStatus writeStatus = busWrite(BNO055_INT_STA_ADDR);
+    if (writeStatus != IO::I2C::I2CStatus::OK) {
+        return writeStatus;
+    }
+
+    return busRead(status);
+}
+
+IO::I2C::I2CStatus IMU::BNO055::resetInterrupts() {
+    // SYS_TRIGGER can be written in any operation mode, so this does not need a configuration transaction
+    uint8_t resetBytes[2] = {BNO055_SYS_TRIGGER_ADDR, BNO055_SYS_TRIGGER_RST_INT};
+    return busWrite(resetBytes, 2);
+}
+
 IO::I2C::I2CStatus IMU::BNO055::fetchData(uint8_t lowestAddress, uint16_t& xBuffer, uint16_t& yBuffer, uint16_t& zBuffer) {
     // Create a buffer to read the 6 bytes of data into that we are about to read.
     uint8_t buffer[6] = {0, 0, 0, 0, 0, 0};
 
     // Write the byte for the address we want to read, this is going to be the lowest bit address of the data.
-    IO::I2C::I2CStatus writeStatus = i2c.write(i2cAddress, lowestAddress);
+    IO::I2C::I2CStatus writeStatus = busWrite(lowestAddress);
     if (writeStatus != IO::I2C::I2CStatus::OK) {
         return writeStatus;
     }
 
     // Read the next 6 bytes from the lowest address we just wrote into the buffer.
-    IO::I2C::I2CStatus readStatus = i2c.read(i2cAddress, buffer, 6);
+    IO::I2C::I2CStatus readStatus = busRead(buffer, 6);
     if (readStatus != IO::I2C::I2CStatus::OK) {
         return readStatus;
     }
@@ -123,3 +153,204 @@ IO::I2C::I2CStatus IMU::BNO055::fetchData(uint8_t lowestAddress, uint16_t& xBuff
 
     return readStatus;
 }
+
+IMU::BNO055::BNO055Status IMU::BNO055::stageRegister(uint8_t page, uint8_t reg, uint8_t value) {
+    uint8_t offset;
+    ShadowWindow* window = findShadowRegister(page, reg, offset);
+    if (window == nullptr || !(window->writableMask & (1u << offset))) {
+        return BNO055::BNO055Status::FAIL_CONFIG;
+    }
+
+    window->staged[offset] = value;
+    // Only mark the register dirty if it actually differs from what is on the chip, so staging a value
+    // back to its current setting does not cost a write.
+    if (window->values[offset] != value) {
+        window->dirtyMask |= (1u << offset);
+    } else {
+        window->dirtyMask &= ~(1u << offset);
+    }
+
+    return BNO055::BNO055Status::OK;
+}
+
+void IMU::BNO055::stageOperationMode(uint8_t mode) {
+    stagedMode = mode;
+}
+
+IO::I2C::I2CStatus IMU::BNO055::commitConfig() {
+    bool dirty = false;
+    for (ShadowWindow& window : shadowWindows) {
+        dirty |= window.dirtyMask != 0;
+    }
+
+    // Nothing to change, so don't interrupt the data output.
+    if (!dirty && stagedMode == currentMode) {
+        return IO::I2C::I2CStatus::OK;
+    }
+
+    // Every configuration change, including moving between two non-config operation modes, has to go through
+    // CONFIG mode. This is the only mode switch of the whole transaction.
+    IO::I2C::I2CStatus status = writeOperationMode(OPERATION_MODE_CONFIG);
+    if (status != IO::I2C::I2CStatus::OK) {
+        return status;
+    }
+
+    for (ShadowWindow& window : shadowWindows) {
+        if (window.dirtyMask == 0) {
+            continue;
+        }
+
+        status = selectPage(window.page);
+        if (status != IO::I2C::I2CStatus::OK) {
+            return status;
+        }
+
+        uint8_t offset = 0;
+        while (offset < window.size) {
+            if (!(window.dirtyMask & (1u << offset))) {
+                offset++;
+                continue;
+            }
+
+            // Merge this register and every dirty register directly after it into one burst write.
+            // The first byte is the starting register, the chip auto-increments for each following byte.
+            uint8_t buffer[MAX_SHADOW_WINDOW_SIZE + 1];
+            uint8_t length = 0;
+            buffer[0] = window.firstAddress + offset;
+            while (offset + length < window.size && (window.dirtyMask & (1u << (offset + length)))) {
+                buffer[length + 1] = window.staged[offset + length];
+                length++;
+            }
+
+            status = busWrite(buffer, length + 1);
+            if (status != IO::I2C::I2CStatus::OK) {
+                return status;
+            }
+
+            for (uint8_t i = offset; i < offset + length; i++) {
+                window.values[i] = window.staged[i];
+                window.dirtyMask &= ~(1u << i);
+            }
+            offset += length;
+        }
+    }
+
+    // Data registers and OPR_MODE are on page 0, so always leave the chip there.
+    status = writeOperationMode(stagedMode);
+    if (status == IO::I2C::I2CStatus::OK) {
+        operatingMode = stagedMode;
+    }
+    return status;
+}
+
+void IMU::BNO055::discardConfig() {
+    for (ShadowWindow& window : shadowWindows) {
+        for (uint8_t i = 0; i < window.size; i++) {
+            window.staged[i] = window.values[i];
+        }
+        window.dirtyMask = 0;
+    }
+    stagedMode = operatingMode;
+}
+
+IMU::BNO055::BNO055Status IMU::BNO055::getShadowRegister(uint8_t page, uint8_t reg, uint8_t& value) {
+    uint8_t offset;
+    ShadowWindow* window = findShadowRegister(page, reg, offset);
+    if (window == nullptr) {
+        return BNO055::BNO055Status::FAIL_CONFIG;
+    }
+
+    value = window->values[offset];
+    return BNO055::BNO055Status::OK;
+}
+
+uint8_t IMU::BNO055::getOperationMode() {
+    return currentMode;
+}
+
+IMU::BNO055::ShadowWindow* IMU::BNO055::findShadowRegister(uint8_t page, uint8_t reg, uint8_t& offset) {
+    for (ShadowWindow& window : shadowWindows) {
+        if (window.page == page && reg >= window.firstAddress && reg < window.firstAddress + window.size) {
+            offset = reg - window.firstAddress;
+            return &window;
+        }
+    }
+    return nullptr;
+}
+
+IO::I2C::I2CStatus IMU::BNO055::selectPage(uint8_t page) {
+    if (page == currentPage) {
+        return IO::I2C::I2CStatus::OK;
+    }
+
+    uint8_t pageBytes[2] = {BNO055_PAGE_ID_ADDR, page};
+    IO::I2C::I2CStatus status = busWrite(pageBytes, 2);
+    // If the write failed we no longer know which page the chip is on, so force the next switch to be sent.
+    currentPage = status == IO::I2C::I2CStatus::OK ? page : 0xFF;
+    return status;
+}
+
+IO::I2C::I2CStatus IMU::BNO055::writeOperationMode(uint8_t mode) {
+    IO::I2C::I2CStatus status = selectPage(BNO055_PAGE_0);
+    if (status != IO::I2C::I2CStatus::OK || mode == currentMode) {
+        return status;
+    }
+
+    uint8_t modeBytes[2] = {BNO055_OPR_MODE_ADDR, mode};
+    status = busWrite(modeBytes, 2);
+    if (status != IO::I2C::I2CStatus::OK) {
+        return status;
+    }
+
+    // The chip ignores the bus while it switches modes, entering CONFIG takes longer than leaving it.
+    time::wait(mode == OPERATION_MODE_CONFIG ? BNO055_ANY_TO_CONFIG_DELAY : BNO055_CONFIG_TO_ANY_DELAY);
+    currentMode = mode;
+    return status;
+}
+
+IO::I2C::I2CStatus IMU::BNO055::syncShadow() {
+    IO::I2C::I2CStatus status;
+    for (ShadowWindow& window : shadowWindows) {
+        status = selectPage(window.page);
+        if (status != IO::I2C::I2CStatus::OK) {
+            return status;
+        }
+
+        status = busWrite(window.firstAddress);
+        if (status != IO::I2C::I2CStatus::OK) {
+            return status;
+        }
+
+        status = busRead(window.values, window.size);
+        if (status != IO::I2C::I2CStatus::OK) {
+            return status;
+        }
+
+        for (uint8_t i = 0; i < window.size; i++) {
+            window.staged[i] = window.values[i];
+        }
+        window.dirtyMask = 0;
+    }
+
+    return selectPage(BNO055_PAGE_0);
+}
+
+IO::I2C::I2CStatus IMU::BNO055::busWrite(uint8_t byte) {
+    ScopedProbe probe(Profiler::Probe::I2C_TRANSACTION);
+    return i2c.write(i2cAddress, byte);
+}
+
+IO::I2C::I2CStatus IMU::BNO055::busWrite(uint8_t* bytes, uint8_t length) {
+    ScopedProbe probe(Profiler::Probe::I2C_TRANSACTION);
+    return i2c.write(i2cAddress, bytes, length);
+}
+
+IO::I2C::I2CStatus IMU::BNO055::busRead(uint8_t& byte) {
+    ScopedProbe probe(Profiler::Probe::I2C_TRANSACTION);
+    return i2c.read(i2cAddress, &byte);
+}
+
+IO::I2C::I2CStatus IMU::BNO055::busRead(uint8_t* bytes, uint8_t length) {
+    ScopedProbe probe(Profiler::Probe::I2C_TRANSACTION);
+    return i2c.read(i2cAddress, bytes, length);
+}
@@ -4,8 +4,21 @@ namespace IO = EVT::core::IO;
 
 namespace IMU {
 
-IMU::IMU(BNO055 bno055) : bno055(bno055) {
-    bno055.setup();
+IMU::IMU(BNO055 bno055, bool onboardFusion) : bno055(bno055), onboardFusion(onboardFusion), powerManager(this->bno055) {
+    // Set up the member copy so the driver's shadowed page and mode match the chip
+    if (this->bno055.setup() != BNO055::BNO055Status::OK || !onboardFusion) {
+        return;
+    }
+
+    // AMG mode gives raw sensor data without the BNO055's fusion, and unlike the fusion modes lets the sensor
+    // bandwidths be set. Gyroscope is 2000 dps at 230 Hz bandwidth (0x08), accelerometer is 4 G at 250 Hz bandwidth (0x15).
+    this->bno055.stageRegister(BNO055_PAGE_1, BNO055_GYR_CONFIG_0_ADDR, 0x08);
+    this->bno055.stageRegister(BNO055_PAGE_1, BNO055_ACC_CONFIG_ADDR, 0x15);
+    this->bno055.stageOperationMode(OPERATION_MODE_AMG);
+    if (this->bno055.commitConfig() != IO::I2C::I2CStatus::OK) {
+        log::LOGGER.log(log::Logger::LogLevel::ERROR, "Failed to configure the BNO055 for on-MCU fusion.\r\n");
+    }
+    resetFusion();
 }
 
 CO_OBJ_T* IMU::getObjectDictionary() {
@@ -21,6 +34,25 @@ uint8_t IMU::getNodeID() {
 }
 
 void IMU::process() {
+    ScopedProbe probe(Profiler::Probe::IMU_PROCESS);
+    PROFILER.processResetRequest();
+
+    // Parking is decided from the previous sample, which is plenty for a timeout measured in seconds
+    bool wasParked = powerManager.getState() == PowerManager::PowerState::PARKED;
+    powerManager.process(isMoving());
+    if (powerManager.getState() == PowerManager::PowerState::PARKED) {
+        // The BNO055 isn't producing new data while parked
+        return;
+    }
+    if (wasParked) {
+        resetFusion();
+    }
+
+    if (onboardFusion) {
+        processFusion();
+        return;
+    }
+
     // Retrieve the Euler X, Y and Z values from the bno055
     bno055.getEuler(vectorXValues[0], vectorYValues[0], vectorZValues[0]);
 
@@ -50,4 +82,80 @@ void IMU::process() {
     log::LOGGER.log(log::Logger::LogLevel::INFO, "Accelerometer Raw z: %d", (int16_t) vectorZValues[3] / 100);
 }
 
+void IMU::wake() {
+    bool wasParked = powerManager.getState() == PowerManager::PowerState::PARKED;
+    powerManager.wake();
+    if (wasParked && powerManager.getState() == PowerManager::PowerState::ACTIVE) {
+        resetFusion();
+    }
+}
+
+PowerManager::PowerState IMU::getPowerState() {
+    return powerManager.getState();
+}
+
+uint16_t IMU::getTPDOPeriod(uint8_t tpdo) {
+    if (tpdo == FUSION_TPDO && !onboardFusion) {
+        return TPDO_DISABLED;
+    }
+    // Slow the TPDOs down while parked, since the data isn't changing
+    if (powerManager.getState() == PowerManager::PowerState::PARKED) {
+        return PARKED_TPDO_PERIOD;
+    }
+    return TPDO_PERIODS[tpdo];
+}
+
+void IMU::processFusion() {
+    // Only the gyroscope and accelerometer are read, to keep the time from sample to output as short as possible
+    if (bno055.getGyroscope(vectorXValues[1], vectorYValues[1], vectorZValues[1]) != IO::I2C::I2CStatus::OK
+        || bno055.getAccelerometer(vectorXValues[3], vectorYValues[3], vectorZValues[3]) != IO::I2C::I2CStatus::OK) {
+        return;
+    }
+
+    // The main loop doesn't run at a fixed rate, so integrate over the time that actually passed since the last sample
+    uint32_t sampleTime = Profiler::now();
+    float dt = (float) (sampleTime - lastFusionTime) / (Profiler::ticksPerMillisecond() * 1000.0f);
+    lastFusionTime = sampleTime;
+
+    // Raw gyroscope data is 16 LSB per dps and raw accelerometer data is 100 LSB per m/s^2
+    constexpr float GYRO_TO_RADIANS = 3.14159265f / (180.0f * 16.0f);
+    constexpr float ACCEL_TO_METERS = 1.0f / 100.0f;
+    {
+        ScopedProbe probe(Profiler::Probe::FUSION_UPDATE);
+        orientationFilter.setSpeed(vehicleSpeed == SPEED_UNKNOWN ? OrientationFilter::SPEED_UNKNOWN : vehicleSpeed / 100.0f);
+        orientationFilter.update((int16_t) vectorXValues[1] * GYRO_TO_RADIANS,
+                                 (int16_t) vectorYValues[1] * GYRO_TO_RADIANS,
+                                 (int16_t) vectorZValues[1] * GYRO_TO_RADIANS,
+                                 (int16_t) vectorXValues[3] * ACCEL_TO_METERS,
+                                 (int16_t) vectorYValues[3] * ACCEL_TO_METERS,
+                                 (int16_t) vectorZValues[3] * ACCEL_TO_METERS,
+                                 dt);
+    }
+
+    // Publish with the same 1/16 degree scale the BNO055 uses for its Euler and gyroscope data
+    constexpr float RADIANS_TO_OUTPUT = (180.0f * 16.0f) / 3.14159265f;
+    fusionValues[0] = (int16_t) (orientationFilter.getLean() * RADIANS_TO_OUTPUT);
+    fusionValues[1] = (int16_t) (orientationFilter.getPitch() * RADIANS_TO_OUTPUT);
+    fusionValues[2] = (int16_t) (orientationFilter.getYawRate() * RADIANS_TO_OUTPUT);
+
+    log::LOGGER.log(log::Logger::LogLevel::DEBUG, "Fusion lean: %d", (int16_t) fusionValues[0] / 16);
+    log::LOGGER.log(log::Logger::LogLevel::DEBUG, "Fusion pitch: %d", (int16_t) fusionValues[1] / 16);
+    log::LOGGER.log(log::Logger::LogLevel::DEBUG, "Fusion yaw rate: %d", (int16_t) fusionValues[2] / 16);
+}
+
+void IMU::resetFusion() {
+    orientationFilter.reset();
+    lastFusionTime = Profiler::now();
+}
+
+bool IMU::isMoving() {
+    int16_t gyro[3] = {(int16_t) vectorXValues[1], (int16_t) vectorYValues[1], (int16_t) vectorZValues[1]};
+    for (int16_t rate : gyro) {
+        if (rate > MOTION_THRESHOLD || rate < -MOTION_THRESHOLD) {
+            return true;
+        }
+    }
+    return false;
+}
+
 }// namespace IMU
@@ -0,0 +1,113 @@
+#include <OrientationFilter.hpp>
+
+#include <cmath>
+
+IMU::OrientationFilter::OrientationFilter(float kp, float ki) : kp(kp), ki(ki) {}
+
+void IMU::OrientationFilter::reset() {
+    initialized = false;
+    q0 = 1.0f;
+    q1 = q2 = q3 = 0.0f;
+    integralX = integralY = integralZ = 0.0f;
+    yawRate = 0.0f;
+}
+
+void IMU::OrientationFilter::setSpeed(float speed) {
+    this->speed = speed;
+}
+
+void IMU::OrientationFilter::update(float gx, float gy, float gz, float ax, float ay, float az, float dt) {
+    // Remove the centripetal acceleration, omega x (speed, 0, 0), using the bias corrected angular velocity.
+    // An unknown speed counts as 0, which leaves the data unchanged.
+    gx += integralX;
+    gy += integralY;
+    gz += integralZ;
+    float knownSpeed = fmaxf(speed, 0.0f);
+    ay -= knownSpeed * gz;
+    az += knownSpeed * gy;
+
+    float accelNorm = sqrtf(ax * ax + ay * ay + az * az);
+
+    // Start from the accelerometer's view of lean and pitch instead of waiting for the filter to converge
+    if (!initialized && accelNorm > 0.0f) {
+        float lean = atan2f(ay, az);
+        float pitch = atan2f(-ax, sqrtf(ay * ay + az * az));
+        float cosLean = cosf(lean * 0.5f), sinLean = sinf(lean * 0.5f);
+        float cosPitch = cosf(pitch * 0.5f), sinPitch = sinf(pitch * 0.5f);
+        q0 = cosLean * cosPitch;
+        q1 = sinLean * cosPitch;
+        q2 = cosLean * sinPitch;
+        q3 = -sinLean * sinPitch;
+        initialized = true;
+    }
+
+    // Direction of gravity in the body frame as predicted by the current orientation
+    float vx = 2.0f * (q1 * q3 - q0 * q2);
+    float vy = 2.0f * (q0 * q1 + q2 * q3);
+    float vz = q0 * q0 - q1 * q1 - q2 * q2 + q3 * q3;
+
+    // Yaw rate is the bias corrected angular velocity projected onto the vertical axis, so it stays correct while
+    // leaned. The proportional correction is left out of it since it carries the accelerometer's noise.
+    yawRate = vx * gx + vy * gy + vz * gz;
+
+    // Trust the accelerometer less the further it is from measuring only gravity. Without a speed, any turn means
+    // uncompensated centripetal acceleration, so the correction is also faded out as the yaw rate grows.
+    float weight = fmaxf(0.0f, 1.0f - fabsf(accelNorm - GRAVITY) / (ACCEL_GATE * GRAVITY));
+    weight *= speed >= 0.0f ? 1.0f : fmaxf(0.0f, 1.0f - fabsf(yawRate) / YAW_RATE_GATE);
+
+    float ex = 0.0f, ey = 0.0f, ez = 0.0f;
+    // With no acceleration reading there is nothing to correct against, so skip the correction. Apart from the
+    // initialization, this is the only data dependent branch, and it only removes work.
+    if (accelNorm > 0.0f) {
+        float recipNorm = weight / accelNorm;
+        ax *= recipNorm;
+        ay *= recipNorm;
+        az *= recipNorm;
+
+        // The error is the rotation between the measured and predicted gravity directions
+        ex = ay * vz - az * vy;
+        ey = az * vx - ax * vz;
+        ez = ax * vy - ay * vx;
+
+        integralX += ki * ex * dt;
+        integralY += ki * ey * dt;
+        integralZ += ki * ez * dt;
+    }
+
+    gx += kp * ex;
+    gy += kp * ey;
+    gz += kp * ez;
+
+    // Integrate the rate of change of the quaternion, qDot = 0.5 * q * (0, g)
+    float halfDt = 0.5f * dt;
+    float qa = q0, qb = q1, qc = q2;
+    q0 += (-qb * gx - qc * gy - q3 * gz) * halfDt;
+    q1 += (qa * gx + qc * gz - q3 * gy) * halfDt;
+    q2 += (qa * gy - qb * gz + q3 * gx) * halfDt;
+    q3 += (qa * gz + qb * gy - qc * gx) * halfDt;
+
+    float recipNorm = 1.0f / sqrtf(q0 * q0 + q1 * q1 + q2 * q2 + q3 * q3);
+    q0 *= recipNorm;
+    q1 *= recipNorm;
+    q2 *= recipNorm;
+    q3 *= recipNorm;
+}
+
+float IMU::OrientationFilter::getLean() {
+    return atan2f(2.0f * (q0 * q1 + q2 * q3), 1.0f - 2.0f * (q1 * q1 + q2 * q2));
+}
+
+float IMU::OrientationFilter::getPitch() {
+    float sinPitch = 2.0f * (q0 * q2 - q3 * q1);
+    // Rounding can push this just past +-1 at vertical, which would make asinf return NaN
+    if (sinPitch > 1.0f) {
+        sinPitch = 1.0f;
+    } else if (sinPitch < -1.0f) {
+        sinPitch = -1.0f;
+    }
+    return asinf(sinPitch);
+}
+
+float IMU::OrientationFilter::getYawRate() {
+    return yawRate;
+}
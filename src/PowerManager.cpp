@@ -0,0 +1,133 @@
+#include <PowerManager.hpp>
+
+IMU::PowerManager::PowerManager(BNO055& bno055) : bno055(bno055), lastTime(time::millis()) {}
+
+void IMU::PowerManager::process(bool moving) {
+    // The DWT cycle counter stops while the MCU sleeps, so the bookkeeping uses the millisecond tick instead
+    uint32_t currentTime = time::millis();
+    uint32_t elapsed = currentTime - lastTime;
+    lastTime = currentTime;
+
+    residency[static_cast<uint8_t>(state)] += elapsed;
+    publish();
+
+    if (wakeRequest || restorePending) {
+        wakeRequest = 0;
+        wake();
+        return;
+    }
+
+    if (getState() == PowerState::PARKED) {
+        if (currentTime - lastPollTime < PARKED_POLL_PERIOD) {
+            return;
+        }
+        lastPollTime = currentTime;
+
+        uint8_t interruptStatus;
+        if (bno055.getInterruptStatus(interruptStatus) == IO::I2C::I2CStatus::OK && (interruptStatus & BNO055_INT_ACC_AM)) {
+            log::LOGGER.log(log::Logger::LogLevel::INFO, "Motion detected, waking up.\r\n");
+            wake();
+        }
+        return;
+    }
+
+    stillTime = moving ? 0 : stillTime + elapsed;
+    if (idleTimeout != PARKING_DISABLED && stillTime >= idleTimeout * 1000u) {
+        log::LOGGER.log(log::Logger::LogLevel::INFO, "No motion for %d s, parking.\r\n", idleTimeout);
+        park();
+    }
+}
+
+void IMU::PowerManager::wake() {
+    stillTime = 0;
+    if (getState() == PowerState::ACTIVE && !restorePending) {
+        return;
+    }
+
+    uint32_t start = time::millis();
+    if (restoreNormalPower() != IO::I2C::I2CStatus::OK) {
+        // Retry on every process() call until it works. The any-motion interrupt can't be relied on for
+        // that, since a wake up requested over CANopen or by the application doesn't set it.
+        log::LOGGER.log(log::Logger::LogLevel::ERROR, "Failed to return the BNO055 to normal power mode.\r\n");
+        restorePending = true;
+        return;
+    }
+    restorePending = false;
+    bno055.resetInterrupts();
+
+    // After a failed park the BNO055 was never parked, so there is no wake up to time
+    if (getState() == PowerState::PARKED) {
+        wakeLatency = time::millis() - start;
+    }
+    state = PowerState::ACTIVE;
+    publish();
+}
+
+IMU::PowerManager::PowerState IMU::PowerManager::getState() {
+    return state;
+}
+
+uint32_t IMU::PowerManager::getResidency(PowerState powerState) {
+    return residency[static_cast<uint8_t>(powerState)];
+}
+
+uint32_t IMU::PowerManager::getWakeLatency() {
+    return wakeLatency;
+}
+
+void IMU::PowerManager::idle() {
+#ifdef __arm__
+    __asm volatile("wfi");
+#endif
+}
+
+void IMU::PowerManager::park() {
+    // Any-motion on all three axes, triggering after 1 consecutive sample over the threshold
+    uint8_t intMask = 0;
+    uint8_t intEnable = 0;
+    bno055.getShadowRegister(BNO055_PAGE_1, BNO055_INT_MSK_ADDR, intMask);
+    bno055.getShadowRegister(BNO055_PAGE_1, BNO055_INT_EN_ADDR, intEnable);
+    bno055.stageRegister(BNO055_PAGE_1, BNO055_ACC_AM_THRES_ADDR, ANY_MOTION_THRESHOLD);
+    bno055.stageRegister(BNO055_PAGE_1, BNO055_ACC_INT_SETTINGS_ADDR, 0x1C);
+    bno055.stageRegister(BNO055_PAGE_1, BNO055_INT_MSK_ADDR, intMask | BNO055_INT_ACC_AM);
+    bno055.stageRegister(BNO055_PAGE_1, BNO055_INT_EN_ADDR, intEnable | BNO055_INT_ACC_AM);
+    bno055.stageRegister(BNO055_PAGE_0, BNO055_PWR_MODE_ADDR, POWER_MODE_LOWPOWER);
+    if (bno055.commitConfig() != IO::I2C::I2CStatus::OK) {
+        // Stay active and try again after another idle timeout. The failed commit can leave the BNO055 in CONFIG
+        // mode with part of the low power settings applied, so undo it, retrying from process() if that fails too.
+        log::LOGGER.log(log::Logger::LogLevel::ERROR, "Failed to put the BNO055 into low power mode.\r\n");
+        stillTime = 0;
+        restorePending = true;
+        wake();
+        return;
+    }
+
+    // Clear anything that fired before parking so only new motion wakes the IMU
+    bno055.resetInterrupts();
+    lastPollTime = time::millis();
+    state = PowerState::PARKED;
+    publish();
+}
+
+IO::I2C::I2CStatus IMU::PowerManager::restoreNormalPower() {
+    // Drop anything a failed commit left staged, which also stages the last committed operating mode again
+    bno055.discardConfig();
+
+    // Disable the any-motion interrupt, leaving any other interrupt settings alone
+    uint8_t intMask = 0;
+    uint8_t intEnable = 0;
+    bno055.getShadowRegister(BNO055_PAGE_1, BNO055_INT_MSK_ADDR, intMask);
+    bno055.getShadowRegister(BNO055_PAGE_1, BNO055_INT_EN_ADDR, intEnable);
+    bno055.stageRegister(BNO055_PAGE_1, BNO055_INT_MSK_ADDR, intMask & ~BNO055_INT_ACC_AM);
+    bno055.stageRegister(BNO055_PAGE_1, BNO055_INT_EN_ADDR, intEnable & ~BNO055_INT_ACC_AM);
+    bno055.stageRegister(BNO055_PAGE_0, BNO055_PWR_MODE_ADDR, POWER_MODE_NORMAL);
+    return bno055.commitConfig();
+}
+
+void IMU::PowerManager::publish() {
+    publishedState = static_cast<uint8_t>(state);
+    for (uint8_t i = 0; i < NUM_POWER_STATES; i++) {
+        publishedResidency[i] = residency[i];
+    }
+    publishedWakeLatency = wakeLatency;
+}
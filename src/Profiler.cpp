@@ -0,0 +1,86 @@
+#include <Profiler.hpp>
+
+#ifdef __arm__
+    /** Debug Exception and Monitor Control Register, TRCENA (bit 24) powers the DWT */
+    #define DEMCR_REG (*(volatile uint32_t*) 0xE000EDFC)
+    /** DWT control register, CYCCNTENA (bit 0) starts the cycle counter */
+    #define DWT_CTRL_REG (*(volatile uint32_t*) 0xE0001000)
+    /** DWT cycle counter */
+    #define DWT_CYCCNT_REG (*(volatile uint32_t*) 0xE0001004)
+
+/** The core clock frequency, maintained by the CMSIS system code */
+extern "C" uint32_t SystemCoreClock;
+#else
+    #include <chrono>
+#endif
+
+namespace IMU {
+
+Profiler PROFILER;
+
+Profiler::Profiler() {
+#ifdef __arm__
+    DEMCR_REG |= 1u << 24;
+    DWT_CYCCNT_REG = 0;
+    DWT_CTRL_REG |= 1u;
+#endif
+}
+
+uint32_t Profiler::now() {
+#ifdef __arm__
+    return DWT_CYCCNT_REG;
+#else
+    return static_cast<uint32_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                                     std::chrono::steady_clock::now().time_since_epoch())
+                                     .count());
+#endif
+}
+
+uint32_t Profiler::ticksPerMillisecond() {
+#ifdef __arm__
+    return SystemCoreClock / 1000;
+#else
+    return 1000000;
+#endif
+}
+
+void Profiler::record(Probe probe, uint32_t start) {
+    // Unsigned subtraction handles the counter wrapping around
+    uint32_t elapsed = now() - start;
+    Histogram& histogram = histograms[static_cast<uint8_t>(probe)];
+
+    // The bit length of the sample picks the bucket, which is a single CLZ instruction on target
+    uint8_t bucket = 0;
+    if (elapsed >> BUCKET_BASE) {
+        bucket = 32 - __builtin_clz(elapsed) - BUCKET_BASE;
+        if (bucket >= NUM_BUCKETS) {
+            bucket = NUM_BUCKETS - 1;
+        }
+    }
+
+    histogram.buckets[bucket]++;
+    if (elapsed > histogram.max) {
+        histogram.max = elapsed;
+    }
+}
+
+void Profiler::reset() {
+    for (Histogram& histogram : histograms) {
+        histogram = {};
+    }
+}
+
+void Profiler::processResetRequest() {
+    if (resetRequest) {
+        reset();
+        resetRequest = 0;
+    }
+}
+
+ScopedProbe::ScopedProbe(Profiler::Probe probe) : probe(probe), start(Profiler::now()) {}
+
+ScopedProbe::~ScopedProbe() {
+    PROFILER.record(probe, start);
+}
+
+}// namespace IMU
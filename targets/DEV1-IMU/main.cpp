@@ -123,9 +123,34 @@ int main() {
 
     //print any CANopen errors
     uart.printf("Error: %d\r\n", CONodeGetErr(&canNode));
+    // Track the NMT mode and power state so changes to them can be acted on
+    CO_MODE nmtMode = CONmtGetMode(&canNode.Nmt);
+    IMU::PowerManager::PowerState powerState = imu.getPowerState();
+
     while (1) {
         imu.process();
 
+        // Any NMT mode change brings the IMU back to full rate
+        if (CONmtGetMode(&canNode.Nmt) != nmtMode) {
+            nmtMode = CONmtGetMode(&canNode.Nmt);
+            imu.wake();
+        }
+
+        // Change the TPDO rates to match the new power state
+        if (imu.getPowerState() != powerState) {
+            powerState = imu.getPowerState();
+            for (uint8_t i = 0; i < IMU::IMU::NUM_TPDOS; i++) {
+                CODictWrWord(&canNode.Dict, CO_DEV(0x1800 + i, 5), imu.getTPDOPeriod(i));
+            }
+        }
+
+        // Wait for the next interrupt while parked instead of spinning. SysTick still ends this every 1 ms, so the
+        // loop keeps running at up to 1 kHz, but the power manager only polls the BNO055 every PARKED_POLL_PERIOD.
+        if (powerState == IMU::PowerManager::PowerState::PARKED) {
+            IMU::PowerManager::idle();
+        }
+
+        IMU::ScopedProbe probe(IMU::Profiler::Probe::CANOPEN_PROCESS);
         IO::processCANopenNode(&canNode);
     }
 }
@@ -0,0 +1,89 @@
+/**
+ * Host test of the BNO055 configuration transactions. Measures the reconfiguration downtime of a
+ * multi-register commit from the simulated time spent in mode switch waits.
+ */
+
+#include "Check.hpp"
+#include "FakeBNO055.hpp"
+
+#include <cstdio>
+
+namespace time = EVT::core::time;
+
+int main() {
+    IMU::test::FakeBNO055 fake;
+    // The MCU was reset partway through a commit, leaving the BNO055 in CONFIG mode on page 1
+    fake.registers[BNO055_PAGE_0][BNO055_PAGE_ID_ADDR] = BNO055_PAGE_1;
+    fake.registers[BNO055_PAGE_1][BNO055_PAGE_ID_ADDR] = BNO055_PAGE_1;
+
+    IMU::BNO055 bno055(fake, 0x28);
+    CHECK(bno055.setup() == IMU::BNO055::BNO055Status::OK);
+    CHECK(bno055.getOperationMode() == OPERATION_MODE_NDOF);
+    CHECK(fake.registers[BNO055_PAGE_0][BNO055_OPR_MODE_ADDR] == OPERATION_MODE_NDOF);
+
+    // Staging a value that is already on the chip costs nothing
+    fake.registerWrites = 0;
+    uint32_t start = time::millis();
+    bno055.stageRegister(BNO055_PAGE_0, BNO055_AXIS_MAP_CONFIG_ADDR, 0x24);
+    CHECK(bno055.commitConfig() == IO::I2C::I2CStatus::OK);
+    CHECK(fake.registerWrites == 0);
+    CHECK(time::millis() == start);
+
+    // Only registers that can't be written through the shadow are rejected
+    CHECK(bno055.stageRegister(BNO055_PAGE_0, BNO055_OPR_MODE_ADDR, 0) == IMU::BNO055::BNO055Status::FAIL_CONFIG);
+    CHECK(bno055.stageRegister(BNO055_PAGE_1, 0x0E, 0) == IMU::BNO055::BNO055Status::FAIL_CONFIG);
+
+    // A typical reconfiguration: units on page 0, and a contiguous interrupt setup on page 1
+    bno055.stageRegister(BNO055_PAGE_0, BNO055_UNIT_SEL_ADDR, 0x01);
+    bno055.stageRegister(BNO055_PAGE_1, BNO055_INT_MSK_ADDR, 0x40);
+    bno055.stageRegister(BNO055_PAGE_1, BNO055_INT_EN_ADDR, 0x40);
+    bno055.stageRegister(BNO055_PAGE_1, BNO055_ACC_AM_THRES_ADDR, 0x0A);
+    bno055.stageRegister(BNO055_PAGE_1, BNO055_ACC_INT_SETTINGS_ADDR, 0x1C);
+
+    fake.registerWrites = 0;
+    start = time::millis();
+    CHECK(bno055.commitConfig() == IO::I2C::I2CStatus::OK);
+    uint32_t downtime = time::millis() - start;
+
+    printf("Multi-register commit: %u register writes, %u ms downtime\n", fake.registerWrites, downtime);
+
+    // To CONFIG, UNIT_SEL, page 1, one burst for INT_MSK..ACC_INT_SETTINGS, page 0, back to NDOF
+    CHECK(fake.registerWrites == 6);
+    // One mode switch each way is the only waiting done
+    CHECK(downtime == BNO055_ANY_TO_CONFIG_DELAY + BNO055_CONFIG_TO_ANY_DELAY);
+
+    CHECK(fake.registers[BNO055_PAGE_0][BNO055_UNIT_SEL_ADDR] == 0x01);
+    CHECK(fake.registers[BNO055_PAGE_1][BNO055_INT_MSK_ADDR] == 0x40);
+    CHECK(fake.registers[BNO055_PAGE_1][BNO055_ACC_INT_SETTINGS_ADDR] == 0x1C);
+    CHECK(fake.registers[BNO055_PAGE_0][BNO055_OPR_MODE_ADDR] == OPERATION_MODE_NDOF);
+    CHECK(fake.page() == BNO055_PAGE_0);
+
+    uint8_t value = 0;
+    CHECK(bno055.getShadowRegister(BNO055_PAGE_1, BNO055_ACC_AM_THRES_ADDR, value) == IMU::BNO055::BNO055Status::OK);
+    CHECK(value == 0x0A);
+
+    // A commit that fails partway leaves the chip in CONFIG mode. Discarding and committing again brings it back
+    // to the last operating mode rather than leaving it in CONFIG.
+    bno055.stageRegister(BNO055_PAGE_1, BNO055_ACC_AM_THRES_ADDR, 0x20);
+    fake.writesBeforeFailure = 1;
+    CHECK(bno055.commitConfig() != IO::I2C::I2CStatus::OK);
+    CHECK(fake.registers[BNO055_PAGE_0][BNO055_OPR_MODE_ADDR] == OPERATION_MODE_CONFIG);
+    fake.writesBeforeFailure = -1;
+    bno055.discardConfig();
+    CHECK(bno055.commitConfig() == IO::I2C::I2CStatus::OK);
+    CHECK(bno055.getOperationMode() == OPERATION_MODE_NDOF);
+    CHECK(fake.registers[BNO055_PAGE_0][BNO055_OPR_MODE_ADDR] == OPERATION_MODE_NDOF);
+    CHECK(fake.registers[BNO055_PAGE_1][BNO055_ACC_AM_THRES_ADDR] == 0x0A);
+
+    // Every transaction, including setup and configuration, was timed by the profiler
+    CHECK(bno055.getInterruptStatus(value) == IO::I2C::I2CStatus::OK);
+    uint32_t probed = 0;
+    for (uint32_t count : IMU::PROFILER.histograms[static_cast<uint8_t>(IMU::Profiler::Probe::I2C_TRANSACTION)].buckets) {
+        probed += count;
+    }
+    printf("%u I2C transactions, %u timed\n", fake.transactions, probed);
+    CHECK(probed == fake.transactions);
+
+    printf("PASSED\n");
+    return 0;
+}
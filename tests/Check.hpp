@@ -0,0 +1,15 @@
+#ifndef IMU_TESTS_CHECK_HPP
+#define IMU_TESTS_CHECK_HPP
+
+#include <cstdio>
+
+/**
+ * Fail the test from main() if a condition doesn't hold, printing where and what failed.
+ */
+#define CHECK(condition)                                               \
+    if (!(condition)) {                                                \
+        printf("FAILED %s:%d: %s\n", __FILE__, __LINE__, #condition); \
+        return 1;                                                      \
+    }
+
+#endif//IMU_TESTS_CHECK_HPP
@@ -0,0 +1,91 @@
+#ifndef IMU_TESTS_FAKEBNO055_HPP
+#define IMU_TESTS_FAKEBNO055_HPP
+
+#include <BNO055.hpp>
+
+namespace IMU::test {
+
+/**
+ * An I2C bus with a BNO055 register file behind it. Models the page switch, the auto-incrementing
+ * register pointer and the interrupt reset, and counts every transaction so tests can check what the
+ * driver put on the bus.
+ */
+class FakeBNO055 : public IO::I2C {
+public:
+    /** Register contents, indexed by page then address */
+    uint8_t registers[2][256] = {};
+
+    /** Number of writes that set registers, not counting pointer-only writes */
+    uint32_t registerWrites = 0;
+
+    /** Number of transactions of any kind */
+    uint32_t transactions = 0;
+
+    /**
+     * Number of register writes that succeed before the bus starts failing every register write,
+     * or -1 for a bus that never fails.
+     */
+    int32_t writesBeforeFailure = -1;
+
+    FakeBNO055() {
+        registers[BNO055_PAGE_0][BNO055_CHIP_ID_ADDR] = BNO055_ID;
+        registers[BNO055_PAGE_0][BNO055_ST_RESULT] = 0x0F;
+        registers[BNO055_PAGE_0][BNO055_AXIS_MAP_CONFIG_ADDR] = 0x24;
+    }
+
+    /** The page the chip is on */
+    uint8_t page() {
+        return registers[BNO055_PAGE_0][BNO055_PAGE_ID_ADDR];
+    }
+
+    I2CStatus write(uint8_t, uint8_t byte) override {
+        transactions++;
+        pointer = byte;
+        return I2CStatus::OK;
+    }
+
+    I2CStatus write(uint8_t, uint8_t* bytes, uint8_t length) override {
+        transactions++;
+        if (writesBeforeFailure == 0) {
+            return I2CStatus::ERROR;
+        } else if (writesBeforeFailure > 0) {
+            writesBeforeFailure--;
+        }
+        registerWrites++;
+        uint8_t reg = bytes[0];
+        for (uint8_t i = 1; i < length; i++, reg++) {
+            if (reg == BNO055_PAGE_ID_ADDR) {
+                // PAGE_ID is readable from both pages
+                registers[BNO055_PAGE_0][reg] = bytes[i];
+                registers[BNO055_PAGE_1][reg] = bytes[i];
+            } else if (page() == BNO055_PAGE_0 && reg == BNO055_SYS_TRIGGER_ADDR) {
+                if (bytes[i] & BNO055_SYS_TRIGGER_RST_INT) {
+                    registers[BNO055_PAGE_0][BNO055_INT_STA_ADDR] = 0;
+                }
+            } else {
+                registers[page()][reg] = bytes[i];
+            }
+        }
+        return I2CStatus::OK;
+    }
+
+    I2CStatus read(uint8_t addr, uint8_t* output) override {
+        return read(addr, output, 1);
+    }
+
+    I2CStatus read(uint8_t, uint8_t* bytes, uint8_t length) override {
+        transactions++;
+        for (uint8_t i = 0; i < length; i++) {
+            bytes[i] = registers[page()][pointer++];
+        }
+        return I2CStatus::OK;
+    }
+
+private:
+    /** The register the next read starts from */
+    uint8_t pointer = 0;
+};
+
+}// namespace IMU::test
+
+#endif//IMU_TESTS_FAKEBNO055_HPP
@@ -0,0 +1,263 @@
+/**
+ * Host accuracy and latency test of the on-MCU orientation fusion. A bike rocking on its stand on a slope, a
+ * slalom, and a long corner are simulated, and the filter's estimates are compared to the true motion. The
+ * latency of the estimate is compared to a model of the BNO055's own 100 Hz Euler output.
+ */
+
+#include "Check.hpp"
+#include <OrientationFilter.hpp>
+#include <Profiler.hpp>
+
+#include <cmath>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+namespace {
+
+constexpr double PI = 3.14159265358979323846;
+constexpr double RAD_TO_DEG = 180.0 / PI;
+constexpr double GRAVITY = 9.80665;
+
+/** Gyroscope bias on each axis, rad/s */
+constexpr double GYRO_BIAS[3] = {0.01, -0.005, 0.008};
+/** Gyroscope noise standard deviation, rad/s */
+constexpr double GYRO_NOISE = 0.01;
+/** Accelerometer noise standard deviation, m/s^2 */
+constexpr double ACCEL_NOISE = 0.2;
+
+/** Time given to the filter to converge before errors are counted, s */
+constexpr double SETTLE_TIME = 5.0;
+
+/**
+ * A simulated ride. The bike moves forward along its X axis at a constant speed with a constant pitch, and its
+ * lean follows a profile. While moving, every turn is coordinated, the yaw rate is the one at which the
+ * centripetal acceleration balances the lean: tan(lean) = -speed * yawRate / g in the BNO055 axes.
+ */
+struct Ride {
+    /** Forward speed, m/s */
+    double speed;
+    /** Constant pitch, rad. Only used with a speed of 0, since the turns are modelled on flat ground */
+    double pitch;
+    /** Lean at a time, rad */
+    double (*lean)(double t);
+    /** Rate of change of the lean at a time, rad/s */
+    double (*leanRate)(double t);
+    /** Total simulated time, s */
+    double runTime;
+    /** Start and end of the time errors are counted over, s */
+    double checkStart;
+    double checkEnd;
+};
+
+/** Rocking side to side on the stand, 0.6 rad at 0.5 Hz */
+double rockingLean(double t) {
+    return 0.6 * sin(PI * t);
+}
+
+double rockingLeanRate(double t) {
+    return 0.6 * PI * cos(PI * t);
+}
+
+/** Flicking from side to side, 0.6 rad at 0.5 Hz */
+double slalomLean(double t) {
+    return 0.6 * sin(PI * t);
+}
+
+double slalomLeanRate(double t) {
+    return 0.6 * PI * cos(PI * t);
+}
+
+/** Ramping into a 40 degree corner over 2 s after riding straight for SETTLE_TIME, then holding it */
+constexpr double CORNER_LEAN = 40.0 / RAD_TO_DEG;
+constexpr double CORNER_RAMP = 2.0;
+
+double cornerLean(double t) {
+    return CORNER_LEAN * fmin(fmax((t - SETTLE_TIME) / CORNER_RAMP, 0.0), 1.0);
+}
+
+double cornerLeanRate(double t) {
+    return t >= SETTLE_TIME && t < SETTLE_TIME + CORNER_RAMP ? CORNER_LEAN / CORNER_RAMP : 0.0;
+}
+
+const Ride ROCKING = {0.0, 0.1, rockingLean, rockingLeanRate, 40.0, SETTLE_TIME, 40.0};
+const Ride SLALOM = {15.0, 0.0, slalomLean, slalomLeanRate, 40.0, SETTLE_TIME, 40.0};
+const Ride CORNER = {20.0, 0.0, cornerLean, cornerLeanRate, SETTLE_TIME + CORNER_RAMP + 9.0, SETTLE_TIME + CORNER_RAMP,
+                     SETTLE_TIME + CORNER_RAMP + 9.0};
+
+/** Errors seen over one simulated run */
+struct RunResult {
+    double maxLeanError;
+    double maxPitchError;
+    double rmsYawRateError;
+    double meanYawRateError;
+    /** Time and lean estimate of every sample, for the latency estimate */
+    std::vector<double> times;
+    std::vector<double> leans;
+};
+
+/**
+ * Simulate a ride, sampling the sensors with periods drawn uniformly from [minPeriod, maxPeriod], and pass the
+ * true time between samples to the filter.
+ *
+ * @param knownSpeed whether the filter is given the speed, or has to handle turns without it.
+ */
+RunResult run(const Ride& ride, double minPeriod, double maxPeriod, bool knownSpeed = true) {
+    IMU::OrientationFilter filter;
+    filter.setSpeed(knownSpeed ? (float) ride.speed : IMU::OrientationFilter::SPEED_UNKNOWN);
+    std::mt19937 rng(1);
+    std::normal_distribution<double> noise(0.0, 1.0);
+    std::uniform_real_distribution<double> period(minPeriod, maxPeriod);
+
+    RunResult result = {};
+    double sumSquaredYawRateError = 0;
+    double sumYawRateError = 0;
+    uint32_t samples = 0;
+
+    double lastT = 0;
+    for (double t = 0; t < ride.runTime; t += period(rng)) {
+        double lean = ride.lean(t);
+        double leanRate = ride.leanRate(t);
+        double yawRate = ride.speed > 0 ? -GRAVITY * tan(lean) / ride.speed : 0.0;
+
+        // Body rates and gravity for yaw-pitch-lean rotation order with constant pitch
+        double gx = leanRate - yawRate * sin(ride.pitch);
+        double gy = yawRate * sin(lean) * cos(ride.pitch);
+        double gz = yawRate * cos(lean) * cos(ride.pitch);
+        // The accelerometer measures gravity plus the acceleration of moving at a constant speed along a
+        // rotating X axis, omega x (speed, 0, 0)
+        double ax = -GRAVITY * sin(ride.pitch);
+        double ay = GRAVITY * sin(lean) * cos(ride.pitch) + gz * ride.speed;
+        double az = GRAVITY * cos(lean) * cos(ride.pitch) - gy * ride.speed;
+
+        filter.update((float) (gx + GYRO_BIAS[0] + GYRO_NOISE * noise(rng)),
+                      (float) (gy + GYRO_BIAS[1] + GYRO_NOISE * noise(rng)),
+                      (float) (gz + GYRO_BIAS[2] + GYRO_NOISE * noise(rng)),
+                      (float) (ax + ACCEL_NOISE * noise(rng)),
+                      (float) (ay + ACCEL_NOISE * noise(rng)),
+                      (float) (az + ACCEL_NOISE * noise(rng)),
+                      (float) (t - lastT));
+        lastT = t;
+
+        if (t < ride.checkStart || t > ride.checkEnd) {
+            continue;
+        }
+
+        result.maxLeanError = fmax(result.maxLeanError, fabs(filter.getLean() - lean));
+        result.maxPitchError = fmax(result.maxPitchError, fabs(filter.getPitch() - ride.pitch));
+        // Angular velocity about the vertical axis. On a slope, part of the lean rate is about the vertical too.
+        double verticalRate = yawRate - leanRate * sin(ride.pitch);
+        double yawRateError = filter.getYawRate() - verticalRate;
+        sumSquaredYawRateError += yawRateError * yawRateError;
+        sumYawRateError += yawRateError;
+        samples++;
+
+        result.times.push_back(t);
+        result.leans.push_back(filter.getLean());
+    }
+
+    result.rmsYawRateError = sqrt(sumSquaredYawRateError / samples);
+    result.meanYawRateError = sumYawRateError / samples;
+    return result;
+}
+
+/**
+ * Print the errors of a run.
+ */
+void print(const char* name, const RunResult& result) {
+    printf("%s: max lean error %.3f deg, max pitch error %.3f deg, yaw rate error rms %.3f dps mean %.3f dps\n",
+           name, result.maxLeanError * RAD_TO_DEG, result.maxPitchError * RAD_TO_DEG,
+           result.rmsYawRateError * RAD_TO_DEG, result.meanYawRateError * RAD_TO_DEG);
+}
+
+/**
+ * Find the delay that best lines a lean signal up with the true lean, searching in 0.1 ms steps.
+ */
+double estimateLag(const std::vector<double>& times, const std::vector<double>& leans, double (*trueLean)(double t)) {
+    double bestLag = 0;
+    double bestError = INFINITY;
+    for (double lag = 0; lag < 0.05; lag += 0.0001) {
+        double error = 0;
+        for (size_t i = 0; i < times.size(); i++) {
+            double difference = leans[i] - trueLean(times[i] - lag);
+            error += difference * difference;
+        }
+        if (error < bestError) {
+            bestError = error;
+            bestLag = lag;
+        }
+    }
+    return bestLag;
+}
+
+}// namespace
+
+int main() {
+    // 500 Hz, the rate the AMG data can be read at
+    RunResult fast = run(ROCKING, 0.002, 0.002);
+    print("Rocking on a slope, 500 Hz", fast);
+    CHECK(fast.maxLeanError * RAD_TO_DEG < 1.0);
+    CHECK(fast.maxPitchError * RAD_TO_DEG < 1.0);
+    CHECK(fast.rmsYawRateError * RAD_TO_DEG < 1.0);
+    // Bias about the vertical axis isn't observable from the accelerometer, so some of it remains in the
+    // yaw rate, but no more than the bias itself (about 0.46 dps vertically here)
+    CHECK(fabs(fast.meanYawRateError) * RAD_TO_DEG < 0.5);
+
+    // A slow, irregular main loop, as long as the filter is given the real time between samples
+    RunResult jittered = run(ROCKING, 0.005, 0.015);
+    print("Rocking on a slope, 5-15 ms jitter", jittered);
+    CHECK(jittered.maxLeanError * RAD_TO_DEG < 2.0);
+    CHECK(jittered.maxPitchError * RAD_TO_DEG < 1.5);
+    CHECK(jittered.rmsYawRateError * RAD_TO_DEG < 1.5);
+    CHECK(fabs(jittered.meanYawRateError) * RAD_TO_DEG < 0.5);
+
+    // Riding, where the accelerometer sees centripetal acceleration on top of gravity
+    RunResult slalom = run(SLALOM, 0.002, 0.002);
+    print("Slalom at 15 m/s, 500 Hz", slalom);
+    CHECK(slalom.maxLeanError * RAD_TO_DEG < 1.0);
+    CHECK(slalom.maxPitchError * RAD_TO_DEG < 1.0);
+    CHECK(slalom.rmsYawRateError * RAD_TO_DEG < 1.0);
+
+    RunResult jitteredSlalom = run(SLALOM, 0.005, 0.015);
+    print("Slalom at 15 m/s, 5-15 ms jitter", jitteredSlalom);
+    CHECK(jitteredSlalom.maxLeanError * RAD_TO_DEG < 2.0);
+    CHECK(jitteredSlalom.maxPitchError * RAD_TO_DEG < 1.5);
+    CHECK(jitteredSlalom.rmsYawRateError * RAD_TO_DEG < 1.5);
+
+    // A sustained corner, where an uncompensated filter would drift back to upright. With the speed the
+    // centripetal acceleration is removed. Without it the correction is gated off and the gyroscope holds the lean,
+    // drifting with whatever gyroscope bias hasn't been estimated yet.
+    RunResult corner = run(CORNER, 0.002, 0.002);
+    print("40 deg corner at 20 m/s, held 9 s", corner);
+    CHECK(corner.maxLeanError * RAD_TO_DEG < 1.0);
+    CHECK(corner.rmsYawRateError * RAD_TO_DEG < 1.0);
+
+    RunResult unknownSpeedCorner = run(CORNER, 0.002, 0.002, false);
+    print("40 deg corner at 20 m/s, held 9 s, unknown speed", unknownSpeedCorner);
+    CHECK(unknownSpeedCorner.maxLeanError * RAD_TO_DEG < 5.0);
+
+    // Latency. The on-MCU estimate is available as soon as a sample is read. The BNO055 only updates its
+    // Euler output every 10 ms, modelled here as a sample and hold of the true lean. The chip's internal
+    // fusion delay is not modelled, so the chip's real latency is at least this.
+    std::vector<double> chipLeans;
+    for (double t : slalom.times) {
+        chipLeans.push_back(slalomLean(floor(t / 0.01) * 0.01));
+    }
+    double filterLag = estimateLag(slalom.times, slalom.leans, slalomLean);
+    double chipLag = estimateLag(slalom.times, chipLeans, slalomLean);
+    printf("Lean latency: on-MCU fusion %.1f ms, BNO055 100 Hz Euler at least %.1f ms\n", filterLag * 1000, chipLag * 1000);
+    CHECK(filterLag < chipLag);
+    // Host cost of an update, for reference only. The target cost is recorded by the FUSION_UPDATE probe.
+    IMU::OrientationFilter filter;
+    uint32_t maxTicks = 0;
+    for (int i = 0; i < 10000; i++) {
+        uint32_t start = IMU::Profiler::now();
+        filter.update(0.01f, 0.02f, 0.03f, 0.1f, 0.2f, 9.8f, 0.002f);
+        uint32_t ticks = IMU::Profiler::now() - start;
+        maxTicks = ticks > maxTicks ? ticks : maxTicks;
+    }
+    printf("Host update cost: max %u ns\n", maxTicks);
+
+    printf("PASSED\n");
+    return 0;
+}
@@ -0,0 +1,157 @@
+/**
+ * Host simulation of the power manager over a day of use: a ride, a long stop on the stand, and another
+ * ride. Reports the wake up latency, including the mode switch waits, and the average BNO055 current
+ * estimated from the time spent in each power state. Also checks recovery from bus failures while
+ * parking and waking up.
+ */
+
+#include "Check.hpp"
+#include "FakeBNO055.hpp"
+#include <PowerManager.hpp>
+
+#include <cstdio>
+
+namespace time = EVT::core::time;
+
+namespace {
+
+/** Time between main loop iterations, ms */
+constexpr uint32_t LOOP_PERIOD = 10;
+
+/** BNO055 current in normal power mode running NDOF, mA (datasheet figure for full operation) */
+constexpr double NORMAL_CURRENT = 12.3;
+
+/**
+ * BNO055 current in low power mode while no motion is seen, mA. In this phase only the accelerometer
+ * runs, in low power mode. This is an estimate, replace it with a measurement from the board when one is
+ * available. The MCU's own current is not included.
+ */
+constexpr double LOW_POWER_CURRENT = 0.33;
+
+/**
+ * Run the main loop for a length of time.
+ *
+ * @return whether the power manager ever parked during the run.
+ */
+bool runFor(IMU::PowerManager& powerManager, uint32_t duration, bool moving) {
+    bool parked = false;
+    uint32_t end = time::millis() + duration;
+    while (time::millis() < end) {
+        powerManager.process(moving);
+        parked |= powerManager.getState() == IMU::PowerManager::PowerState::PARKED;
+        time::wait(LOOP_PERIOD);
+    }
+    return parked;
+}
+
+}// namespace
+
+int main() {
+    IMU::test::FakeBNO055 fake;
+    IMU::BNO055 bno055(fake, 0x28);
+    CHECK(bno055.setup() == IMU::BNO055::BNO055Status::OK);
+
+    // Parking can be disabled, and then never happens however long the bike is still
+    {
+        IMU::PowerManager powerManager(bno055);
+        powerManager.idleTimeout = IMU::PowerManager::PARKING_DISABLED;
+        CHECK(!runFor(powerManager, 3600 * 1000, false));
+    }
+
+    IMU::PowerManager powerManager(bno055);
+
+    // A 30 minute ride, which never parks
+    CHECK(!runFor(powerManager, 30 * 60 * 1000, true));
+
+    // Stopped for 8 hours. The IMU parks after the idle timeout and stays parked.
+    runFor(powerManager, IMU::PowerManager::DEFAULT_IDLE_TIMEOUT * 1000 + 1000, false);
+    CHECK(powerManager.getState() == IMU::PowerManager::PowerState::PARKED);
+    uint32_t parkedTransactions = fake.transactions;
+    runFor(powerManager, 8 * 3600 * 1000 - IMU::PowerManager::DEFAULT_IDLE_TIMEOUT * 1000 - 1000, false);
+    CHECK(powerManager.getState() == IMU::PowerManager::PowerState::PARKED);
+    // Polling the interrupt status is a register select and a read, no more often than PARKED_POLL_PERIOD
+    double pollRate = (fake.transactions - parkedTransactions) / 2.0 / (8 * 3600 - IMU::PowerManager::DEFAULT_IDLE_TIMEOUT - 1);
+    printf("Interrupt status polls while parked: %.1f per second\n", pollRate);
+    CHECK(pollRate <= 1000.0 / IMU::PowerManager::PARKED_POLL_PERIOD);
+    CHECK(fake.registers[BNO055_PAGE_0][BNO055_PWR_MODE_ADDR] == POWER_MODE_LOWPOWER);
+    CHECK(fake.registers[BNO055_PAGE_1][BNO055_INT_EN_ADDR] & BNO055_INT_ACC_AM);
+
+    // Writing the published state over CANopen doesn't change the real state
+    powerManager.publishedState = 7;
+    powerManager.process(false);
+    CHECK(powerManager.getState() == IMU::PowerManager::PowerState::PARKED);
+    CHECK(powerManager.publishedState == static_cast<uint8_t>(IMU::PowerManager::PowerState::PARKED));
+
+    // The bike is moved, so the BNO055 raises the any-motion interrupt. It is seen by the next poll.
+    fake.registers[BNO055_PAGE_0][BNO055_INT_STA_ADDR] = BNO055_INT_ACC_AM;
+    uint32_t motionTime = time::millis();
+    while (powerManager.getState() == IMU::PowerManager::PowerState::PARKED) {
+        powerManager.process(true);
+        time::wait(LOOP_PERIOD);
+    }
+    CHECK(time::millis() - motionTime <= IMU::PowerManager::PARKED_POLL_PERIOD + LOOP_PERIOD);
+    CHECK(fake.registers[BNO055_PAGE_0][BNO055_PWR_MODE_ADDR] == POWER_MODE_NORMAL);
+    CHECK(fake.registers[BNO055_PAGE_0][BNO055_OPR_MODE_ADDR] == OPERATION_MODE_NDOF);
+    CHECK(!(fake.registers[BNO055_PAGE_1][BNO055_INT_EN_ADDR] & BNO055_INT_ACC_AM));
+
+    // Another 30 minute ride
+    CHECK(!runFor(powerManager, 30 * 60 * 1000, true));
+    powerManager.process(true);
+
+    uint32_t wakeLatency = powerManager.getWakeLatency();
+    uint32_t active = powerManager.getResidency(IMU::PowerManager::PowerState::ACTIVE);
+    uint32_t parked = powerManager.getResidency(IMU::PowerManager::PowerState::PARKED);
+    double total = (double) active + parked;
+    double averageCurrent = (active * NORMAL_CURRENT + parked * LOW_POWER_CURRENT) / total;
+
+    printf("Wake up latency: %u ms (poll to normal power, not including up to %u ms until the next poll)\n",
+           wakeLatency, IMU::PowerManager::PARKED_POLL_PERIOD);
+    printf("Residency: active %.1f min, parked %.1f min\n", active / 60000.0, parked / 60000.0);
+    printf("Average BNO055 current: %.2f mA, %.2f mA without parking\n", averageCurrent, NORMAL_CURRENT);
+
+    // Waking is one trip through CONFIG mode
+    CHECK(wakeLatency == BNO055_ANY_TO_CONFIG_DELAY + BNO055_CONFIG_TO_ANY_DELAY);
+    // Active for both rides and the idle timeout before parking, give or take the mode switches
+    CHECK(active / 1000 >= 2 * 30 * 60 + IMU::PowerManager::DEFAULT_IDLE_TIMEOUT);
+    CHECK(active / 1000 <= 2 * 30 * 60 + IMU::PowerManager::DEFAULT_IDLE_TIMEOUT + 1);
+    CHECK(averageCurrent < NORMAL_CURRENT / 4);
+
+    // A bus failure partway through parking leaves the BNO055 in CONFIG mode. While the bus is still down
+    // the IMU stays active, and once it recovers the BNO055 is put back into normal power NDOF with nothing
+    // left staged.
+    IMU::PowerManager failingPowerManager(bno055);
+    failingPowerManager.idleTimeout = 1;
+    fake.writesBeforeFailure = 2;
+    runFor(failingPowerManager, 2000, false);
+    CHECK(failingPowerManager.getState() == IMU::PowerManager::PowerState::ACTIVE);
+    CHECK(fake.registers[BNO055_PAGE_0][BNO055_OPR_MODE_ADDR] == OPERATION_MODE_CONFIG);
+    fake.writesBeforeFailure = -1;
+    failingPowerManager.process(false);
+    CHECK(failingPowerManager.getState() == IMU::PowerManager::PowerState::ACTIVE);
+    CHECK(fake.page() == BNO055_PAGE_0);
+    CHECK(fake.registers[BNO055_PAGE_0][BNO055_OPR_MODE_ADDR] == OPERATION_MODE_NDOF);
+    CHECK(fake.registers[BNO055_PAGE_0][BNO055_PWR_MODE_ADDR] == POWER_MODE_NORMAL);
+    CHECK(!(fake.registers[BNO055_PAGE_1][BNO055_INT_EN_ADDR] & BNO055_INT_ACC_AM));
+    uint32_t writes = fake.registerWrites;
+    CHECK(bno055.commitConfig() == IO::I2C::I2CStatus::OK);
+    CHECK(fake.registerWrites == writes);
+
+    // With the bus working again it parks normally
+    runFor(failingPowerManager, 2000, false);
+    CHECK(failingPowerManager.getState() == IMU::PowerManager::PowerState::PARKED);
+
+    // A wake up requested over CANopen while the bus is down is retried without any motion interrupt
+    fake.writesBeforeFailure = 0;
+    failingPowerManager.wakeRequest = 1;
+    failingPowerManager.process(false);
+    CHECK(failingPowerManager.getState() == IMU::PowerManager::PowerState::PARKED);
+    fake.writesBeforeFailure = -1;
+    failingPowerManager.process(false);
+    CHECK(failingPowerManager.getState() == IMU::PowerManager::PowerState::ACTIVE);
+    CHECK(fake.registers[BNO055_PAGE_0][BNO055_OPR_MODE_ADDR] == OPERATION_MODE_NDOF);
+    CHECK(fake.registers[BNO055_PAGE_0][BNO055_PWR_MODE_ADDR] == POWER_MODE_NORMAL);
+    CHECK(!(fake.registers[BNO055_PAGE_1][BNO055_INT_EN_ADDR] & BNO055_INT_ACC_AM));
+
+    printf("PASSED\n");
+    return 0;
+}
@@ -0,0 +1,28 @@
+#ifndef IMU_TESTS_STUBS_I2C_HPP
+#define IMU_TESTS_STUBS_I2C_HPP
+
+#include <cstdint>
+
+namespace EVT::core::IO {
+
+/**
+ * Host stand-in for the EVT-core I2C interface, exposing only the raw calls the BNO055 driver uses.
+ */
+class I2C {
+public:
+    enum class I2CStatus {
+        OK = 0,
+        TIMEOUT = 1,
+        BUSY = 2,
+        ERROR = 3
+    };
+
+    virtual I2CStatus write(uint8_t addr, uint8_t byte) = 0;
+    virtual I2CStatus write(uint8_t addr, uint8_t* bytes, uint8_t length) = 0;
+    virtual I2CStatus read(uint8_t addr, uint8_t* output) = 0;
+    virtual I2CStatus read(uint8_t addr, uint8_t* bytes, uint8_t length) = 0;
+};
+
+}// namespace EVT::core::IO
+
+#endif//IMU_TESTS_STUBS_I2C_HPP
@@ -0,0 +1,26 @@
+#ifndef IMU_TESTS_STUBS_LOG_HPP
+#define IMU_TESTS_STUBS_LOG_HPP
+
+namespace EVT::core::log {
+
+/**
+ * Host stand-in for the EVT-core logger, which drops every message.
+ */
+class Logger {
+public:
+    enum class LogLevel {
+        DEBUG = 0,
+        INFO = 1,
+        WARNING = 2,
+        ERROR = 3
+    };
+
+    template<typename... Args>
+    void log(LogLevel, const char*, Args...) {}
+};
+
+inline Logger LOGGER;
+
+}// namespace EVT::core::log
+
+#endif//IMU_TESTS_STUBS_LOG_HPP
@@ -0,0 +1,24 @@
+#ifndef IMU_TESTS_STUBS_TIME_HPP
+#define IMU_TESTS_STUBS_TIME_HPP
+
+#include <cstdint>
+
+namespace EVT::core::time {
+
+/**
+ * Simulated milliseconds since startup. Waiting advances it instantly, so tests can measure
+ * exactly how much time the driver spends blocked.
+ */
+inline uint32_t simulatedMillis = 0;
+
+inline void wait(uint32_t ms) {
+    simulatedMillis += ms;
+}
+
+inline uint32_t millis() {
+    return simulatedMillis;
+}
+
+}// namespace EVT::core::time
+
+#endif//IMU_TESTS_STUBS_TIME_HPP